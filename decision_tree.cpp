@@ -1,585 +1,5731 @@
-#include <iostream>
-#include <vector>
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <map>
-#include <cmath>
-#include <algorithm>
-#include <memory>
-#include <random>
-#include <chrono>
-
-using namespace std;
-
-struct Node {
-    string featureName; //string to represent the name of feature used for splitting
-    int featureIndex;  //column index of that feature in the data
-    string label;      //string label if the node is a leaf
-    bool isLeaf;       //true if this node is a leaf node (if it is a leaf then that node stores the final answer)
-    map<string, Node*> children; //map used to connect feature values to the child nodes so that the tree knows which branch to follow
-    
-    Node() : featureIndex(-1), isLeaf(false) {} //constructor that runs when a new node is created
-                                                //It sets the featureIndex = -1 and sets isLeaf = false (assuming it's not a leaf at first)
-    
-    ~Node() { //destructor that runs when the node is destroyed
-        for(auto& pair : children) { //loops through every (key,value) in the children map
-            delete pair.second;  //deletes each child node
-        }
-    }
-};
-
-void splitData(const vector<vector<string>>& data,
-               vector<vector<string>>& trainData,
-               vector<vector<string>>& testData,
-               double trainRatio = 0.7) {
-
-    vector<vector<string>> temp = data; //make a copy of the whole dataset
-    random_device rd; //random number generator that is used to randomly shuffle the copied data
-    mt19937 g(rd()); 
-    shuffle(temp.begin(), temp.end(), g);
-
-    int trainSize = (int)(temp.size() * trainRatio); //calculate how many samples go into training
-
-    for (int i = 0; i < (int)temp.size(); i++) { //loop through every row in the shuffled dataset
-        if (i < trainSize)  //check if the row's index is less than the training split
-             trainData.push_back(temp[i]); //if it is, enter the training set
-        else  //if not
-            testData.push_back(temp[i]); //the training rows go into the test set
-    }
-}
-
-vector<vector<string>> loadDataFile(const string& filename, char delimiter=',') {
-    ifstream file(filename);
-    if (!file) {
-        cerr << "Error opening file: " << filename << endl;
-        exit(1);
-    }
-    
-    vector<vector<string>> data;
-    string line;
-    
-    while (getline(file, line)) { //check if the file failed to open
-        // Skip empty lines
-        if (line.empty() || line.find_first_not_of(" \t\r\n") == string::npos) { //skip empty or whitespace only lines
-            continue;
-        }
-        
-        vector<string> row; //vector to store column values for this line
-        stringstream ss(line); //convert the line into a stringstream so we can read each cell 
-        string cell;
-        
-        while (getline(ss, cell, delimiter)) {
-            // Trim whitespace but KEEP empty cells
-            cell.erase(0, cell.find_first_not_of(" \t\r\n"));
-            cell.erase(cell.find_last_not_of(" \t\r\n") + 1);
-            
-            // Add the cell even if it's empty
-            row.push_back(cell);
-        }
-        
-        if (!row.empty()) {
-            data.push_back(row);
-        }
-    }
-    
-    return data;
-}
-
-
-//Gini Index
-double giniImpurity(const vector<vector<string>>& data, int labelIndex) { //function to measure how mixed the classes are in a dataset
-    if(data.empty()) //check to see if the data is empty
-        return 0.0;
-    
-    map<string,int> counts; //map to store the class label and the number of times this label appears in the dataset
-    for(const auto& row : data) { //count how many samples belong to each class
-        counts[row[labelIndex]]++;  //increment the count for that label
-    }
-    
-    double gini = 1.0; //initalizing the gini impurity to 1
-    int total = data.size(); //stores the total number of samples in the dataset
-    for(const auto& kv : counts) { //loop over each class in counts 
-                                   // kv.first = class label 
-                                   // kv.second = count of samples in that class
-        double p = (double)kv.second / total;  // p = count/total gives us the total fractions of samples in that class
-        gini -= p * p;  // subtract the squared probability from 1 (per the gini formula)
-    }
-    return gini; //return the gini impurity for this dataset/node
-}
-
-double giniSplit(const vector<vector<string>>& data, int featureIndex, int labelIndex) { //function how pure the data is after splitting by a feature
-    map<string, vector<vector<string>>> subsets; //create a map that stores the feature value and the rows that have that value
-    for(const auto& row : data) { //loop through every row in the dataset
-        subsets[row[featureIndex]].push_back(row); //for the current row, look at the value of the chosen feature use it as a key in the map
-    }
-    
-    double weightedGini = 0.0; //variable to store the final impurity value
-    int total = data.size(); //int variable to store the total number of rows before splitting
-    for(const auto& kv : subsets) { //loop through each group in the map
-        double weight = (double)kv.second.size() / total; //calculate the weight of the group
-        weightedGini += weight * giniImpurity(kv.second, labelIndex); //multiply it by the group's weight and then add the result to the total
-    }
-    return weightedGini; //return the final impurity score (the lower the value = better feature to split on)
-}
-
-//Information Gain 
-double entropy(const vector<vector<string>>& data, int labelIndex) {
-    if(data.empty()) //if the dataset is empty, return 0.0
-        return 0.0;
-    
-    map<string,int> counts; //map to store the label and how many time it appears
-    for(const auto& row : data) { //loop throuh every row and look at the label column
-        counts[row[labelIndex]]++; //increase the count for that label
-    }
-    
-    double entropyValue = 0.0; 
-    int total = data.size();//store the total number fo rows in total
-    for(const auto& kv : counts) { //loop over the entries in the counts map
-        double p = (double)kv.second / total; //calculate the probability of the current label (count/total)
-        if(p > 0) { //if p is greater than 0, compute the formula
-                    //if not, don't
-            entropyValue -= p * log2(p);
-        }
-    }
-    return entropyValue; //return the final entropy value computed
-}
-
-double informationGain(const vector<vector<string>>& data, int featureIndex, int labelIndex) {  //function that picks the feature with the highest information gain to split the data
-    double totalEntropy = entropy(data, labelIndex); //call entropy function to find out how mixed the class labels are before any splitting
-    
-    map<string, vector<vector<string>>> subsets; //map that stores the feature value and the number of rows with that value
-    for(const auto& row : data) { //loop through every row and look at the value in the column we are splitting on
-                                  //use that avlue as a key in the map
-        subsets[row[featureIndex]].push_back(row); //add the full row into the group
-    }
-    
-    double subsetEntropy = 0.0;
-    int total = data.size(); //int variable to store the total number of rows in the dataset
-    for(const auto& kv : subsets) { //loop through each group 
-        double weight = (double)kv.second.size() / total; // calculate the weight of this group
-        subsetEntropy += weight * entropy(kv.second, labelIndex); //multiply it by the group's weight and add it to the running total
-    }
-    
-    return totalEntropy - subsetEntropy; //subtract the entropy befor ethe slide and the entropy after the split 
-                                         //this gives us the information gain
-}
-
-
-//function that will be used in the gainRatio metric
-double splitInfo(const vector<vector<string>>& data, int featureIndex) {
-    return entropy(data, featureIndex); //call entropy function of the feature column
-}
-
-double gainRatio(const vector<vector<string>>& data, int featureIndex, int labelIndex) {
-    double infoGain = informationGain(data, featureIndex, labelIndex); //call informationGain function and store how much the feature reudesc the label uncertainity
-    double splitInformation = splitInfo(data, featureIndex); //call splitInfo to measure how spread out the feature values are
-
-    if (splitInformation == 0.0 || splitInformation < 1e-10) //safety check to avoid dividing by zero
-        return 0.0;                                          //if splitInformatoin is zero or extremely small -> return 0
-
-    return infoGain / splitInformation; //Gain ratio = information gain / split info
-}
-
-string majorityLabel(const vector<vector<string>>& data, int labelIndex) { //function to find and return the label that appears the most in the dataset
-    map<string,int> counts; //map to store the label and the number of times it appears
-    for(const auto& row : data) { //loop throuh every row in the dataset
-        counts[row[labelIndex]]++; //Increase teh value in the label column by 1
-    }
-    
-    string majLabel;
-    int maxCount = 0;
-    for(const auto& kv : counts) { //loop through every label in the map
-                                   //kv. first = the label (like "yes" or "no")
-                                   //kv.second = how many times it appeared
-        if(kv.second > maxCount) { //check to see if the label's count is bigger than the current biggest count
-            maxCount = kv.second; //if it is, update maxCount and store the label as the current most common label
-            majLabel = kv.first;
-        }
-    }
-    return majLabel; //return the label that appeard the most number of times
-}
-
-Node* buildTree(const vector<vector<string>>& data, vector<int> featureIndices, 
-                int labelIndex, const string& metric, const vector<string>& attributeNames,
-                int depth = 0, int maxDepth = 8) { //recursive function that builds the decision tree
-    
-    if(data.empty()) {   //Base Case 1: If there is no data
-                        //Create a leaf node and label it as unknown
-        Node* leaf = new Node(); 
-        leaf->isLeaf = true;
-        leaf->label = "unknown";
-        return leaf;
-    }
-    
-    //Base Case 2: All labels are the same
-    string firstLabel = data[0][labelIndex]; //take the label from the first row and store it (almost like a reference label to compare everything else against)
-    bool allSame = true;  //assumes all labels are the same (this assumption is tested)
-    for(const auto& row : data) { //loop through every row in the dataset
-        if(row[labelIndex] != firstLabel) { //compare the current row's label with the first label
-            allSame = false;                //if they are different, then set the boolean variable to false
-            break;
-        }
-    }
-    if(allSame) {
-        Node* leaf = new Node();
-        leaf->isLeaf = true;
-        leaf->label = firstLabel;
-        return leaf;
-    }
-    
-    //Base Case 3: No features left or the maximum depth has been reached
-    if(featureIndices.empty() || depth >= maxDepth) { //if no  more features to split or tree is too deep then create a leaf node and label it with the most common class
-        Node* leaf = new Node(); 
-        leaf->isLeaf = true;
-        leaf->label = majorityLabel(data, labelIndex);
-        return leaf;
-    }
-    
-    double bestScore = -1e9; 
-    int bestFeature = -1; //sentinel
-    
-    for(int f : featureIndices) { //loop over each candidate feature index f in featureIndices
-        double score = 0.0; //variable to hold the metric value for the feature f
-        
-        if(metric == "gini") { //if the chosen metric is gini,call giniSplit which returns the weighted gini impurity after splitting on feature f
-            score = -giniSplit(data, f, labelIndex); //lower giniIndex is better so we negate it
-        }
-        else if(metric == "info") { //if the chosen metric is info, call the informationGain
-            score = informationGain(data, f, labelIndex);
-        }
-        else if(metric == "gain") { //if the metric is gain, call the gainRatio
-            score = gainRatio(data, f, labelIndex);
-        }
-        
-        if(score > bestScore) { //after computing the score for the current feature, check to see if score > bestScore
-                                //if so, update the bestScore and set bestFeature to the current feature index f
-            bestScore = score;
-            bestFeature = f;
-        }
-    }
-    
-    if(bestFeature == -1) { //check if no feature was chosen (this can happen if featureIndicies was empty or scores were not better than the initial bestScore)
-        Node* leaf = new Node();    // if true, then create a leaf node and set its label to the majority label
-        leaf->isLeaf = true;
-        leaf->label = majorityLabel(data, labelIndex);
-        return leaf;
-    }
-    
-    Node* node = new Node(); //create a new node and store the featureIndex and featureName
-    node->isLeaf = false;
-    node->featureIndex = bestFeature;
-    node->featureName = attributeNames[bestFeature];
-    
-    map<string, vector<vector<string>>> subsets; //map to store the feature value and the vector of rows that have that feature value
-    for(const auto& row : data) { //loop through all rows and append each row into the corresponding bucket
-        subsets[row[bestFeature]].push_back(row);
-    }
-    
-    vector<int> remainingFeatures; //new list to ensure that the same feature is not reused down the branch
-    for(int f : featureIndices) {
-        if(f != bestFeature) {
-            remainingFeatures.push_back(f);
-        }
-    }
-    
-    for(auto& kv : subsets) { //loop throuh subsets and recursively call buildTree 
-        node->children[kv.first] = buildTree(kv.second, remainingFeatures, 
-                                             labelIndex, metric, attributeNames, depth + 1, maxDepth);
-    }
-    
-    return node;
-}
-
-string predict(Node* node, const vector<string>& sample) { //function that classifies one row of data
-    if(node->isLeaf) { //if the current node is a leaf node then there are no more decisions to make and just reutnr its label
-        return node->label;
-    }
-    
-    string featureValue = sample[node->featureIndex]; //string that retrieves the value from the intput sample at the feature this node splits on
-    
-    if(node->children.find(featureValue) != node->children.end()) { //check tosee if the tree has a child branch for that feature value
-        return predict(node->children[featureValue], sample);
-    }
-    
-    map<string, int> labelCounts; //map to count how often each label appears among the children
-    for(auto& pair : node->children) { //loop through all children of this node and check to see if the child is a leaf node
-                                        //if it is a leaf node, simply increase the count for that child's label
-        if(pair.second->isLeaf) {
-            labelCounts[pair.second->label]++;
-        }
-    }
-    
-    string bestLabel; //string to store the most common label
-    int maxCount = 0; //int to store the highest count
-    for(auto& pair : labelCounts) { //loop throuh over the label coutns and pick the label with the largest frequency
-        if(pair.second > maxCount) { 
-            maxCount = pair.second;
-            bestLabel = pair.first;
-        }
-    }
-    
-    if (bestLabel.empty()) { //if no label was found (meaning that no leaf children existed) simply return uknown
-         return "unknown";
-    } else {
-         return bestLabel;  //else return the most common label
-    }
-}
-
-double calculateAccuracy(Node* tree, const vector<vector<string>>& data, int labelIndex) { //function to measure how accruate the decision tree is
-    int correct = 0; //counter to store how many predictions are correct
-    for(const auto& row : data) {  //loop through every row in the dataset
-        string pred = predict(tree, row); //call prediction funciton and store the predicited label in the string variable pred
-        if(pred == row[labelIndex]) { //compare the predicited label to the actual true label from the dataset
-            correct++;  //if they match, increase tehcorrect counter
-        }
-    }
-    return (double)correct / data.size() * 100.0; //calculate the final accuracy and then multiply by 100% to get a percentage
-}
-
-int main() {
-    cout << "Decision Tree Classifier\n";
-    cout << "Available Datasets:\n";
-    cout << "  1. Thyroid Dataset\n";
-    cout << "  2. Adult\n";
-    cout << "  3. Mushroom\n";
-    cout << "  4. Car Evaluation\n";
-    cout << "  5. Nursery\n";
-    cout << "  6. Letter Recognition\n";
-    cout << "  7. Chess (KR vs KP)\n";
-    cout << "  8. Pen-Based Recognition\n";
-    cout << "  9. Tic-Tac-Toe\n";
-    cout << " 10. Test Dataset (Play Tennis)\n";
-    cout << " 11. Student Data\n";
-    cout << "Enter dataset number (1-10): ";
-    
-    int choice; 
-    cin >> choice;
-
-    string inputFile;
-    vector<string> attributeNames;
-    string labelName;
-    
-    switch (choice) { 
-        case 1:
-            inputFile = "Thyroid_Diff.csv";
-            attributeNames = {"Age","Gender", "Smoking","Hx_Smoking","Hx_Radiotherapy","Thyroid_Function","Physical_examination","Adenopathy","Pathology","Focality","Risk", "T", "N", "M","Stage", "Response", "Target"};
-            labelName = "Target";
-            break;
-        case 2:
-            inputFile = "adult.data";
-            attributeNames = {
-                "age", "workclass", "fnlwgt", "education", "education-num",
-                "marital-status", "occupation", "relationship", "race", "sex",
-                "capital-gain", "capital-loss", "hours-per-week", "native-country",
-                "income"
-            };
-            labelName = "income";
-            break;
-        case 3:
-            inputFile = "agaricus-lepiota.data";
-            attributeNames = {
-                "class", "cap-shape","cap-surface","cap-color","bruises","odor",
-                "gill-attachment","gill-spacing","gill-size","gill-color",
-                "stalk-shape","stalk-root","stalk-surface-above-ring",
-                "stalk-surface-below-ring","stalk-color-above-ring",
-                "stalk-color-below-ring","veil-type","veil-color","ring-number",
-                "ring-type","spore-print-color","population","habitat"
-            };
-            labelName = "class";
-            break;
-        case 4:
-            inputFile = "car.data";
-            attributeNames = {"buying", "maint", "doors", "persons", "lug_boot", "safety", "evaluation"};
-            labelName = "evaluation";
-            break;
-        case 5:
-            inputFile = "nursery.data";
-            attributeNames = {
-                "parents","has_nurs","form","children","housing",
-                "finance","social","health","evaluation"
-            };
-            labelName = "evaluation";
-            break;
-        case 6:
-            inputFile = "letter-recognition.data";
-            attributeNames = {
-                "letter", "x-box", "y-box","width","high","onpix","x-bar",
-                "y-bar","x2bar","y2bar","xybar","x2ybr","xy2br",
-                "x-ege","xegvy","y-ege","yegvx"
-            };
-            labelName = "letter";
-            break;
-        case 7:
-            inputFile = "krkopt.data";
-            attributeNames = {
-                "white-king-file", "white-king-rank", "white-rook-file",
-                "white-rook-rank", "black-king-file", "black-king-rank", "outcome"
-            };
-            labelName = "outcome";
-            break;
-        case 8:
-            inputFile = "pen_based.data";
-            attributeNames = {
-                "x1","x2","x3","x4","x5","x6","x7","x8","x9","x10",
-                "x11","x12","x13","x14","x15","x16","digit"
-            };
-            labelName = "digit";
-            break;
-        case 9:
-            inputFile = "tic-tac-toe.data";
-            attributeNames = {
-                "top-left", "top-middle", "top-right",
-                "middle-left", "middle-middle", "middle-right",
-                "bottom-left", "bottom-middle", "bottom-right",
-                "outcome"
-            };
-            labelName = "outcome";
-            break;
-        case 10:
-            inputFile = "test.data";
-            attributeNames = {"Outlook", "Temperature", "Humidity", "Wind", "PlayTennis"};
-            labelName = "PlayTennis";
-            break;
-        case 11:
-            inputFile = "students.data";
-            attributeNames = {
-            "marital_status",
-            "application_mode",
-            "application_order",
-            "course",
-            "daytime_evening_attendance",
-            "previous_qualification",
-            "previous_qualification_grade",
-            "nationality",
-            "mothers_qualification",
-            "fathers_qualification",
-            "mothers_occupation",
-            "fathers_occupation",
-            "admission_grade",
-            "displaced",
-            "educational_special_needs",
-            "debtor",
-            "tuition_fees_up_to_date",
-            "gender",
-            "scholarship_holder",
-            "age_at_enrollment",
-            "international",
-            "curricular_units_1st_sem_credited",
-            "curricular_units_1st_sem_enrolled",
-            "curricular_units_1st_sem_evaluations",
-            "curricular_units_1st_sem_approved",
-            "curricular_units_1st_sem_grade",
-            "curricular_units_1st_sem_without_evaluations",
-            "curricular_units_2nd_sem_credited",
-            "curricular_units_2nd_sem_enrolled",
-            "curricular_units_2nd_sem_evaluations",
-            "curricular_units_2nd_sem_approved",
-            "curricular_units_2nd_sem_grade",
-            "curricular_units_2nd_sem_without_evaluations",
-            "unemployment_rate",
-            "inflation_rate",
-            "gdp",
-            "target"       
-          };
-            labelName = "target";
-    break;
-        default:
-            cerr << "Invalid choice\n";
-            return 1;
-    }
-
-    // Find label index from attribute names
-    int labelIndex = -1;
-    for(int i = 0; i < attributeNames.size(); i++) {
-        if(attributeNames[i] == labelName) {
-            labelIndex = i;
-            break;
-        }
-    }
-    
-    if(labelIndex == -1) {
-        cerr << "Label '" << labelName << "' not found in attributes!\n";
-        return 1;
-    }
-
-    cout << "\nSelect metric:\n";
-    cout << "1. Gini Index\n";
-    cout << "2. Information Gain\n";
-    cout << "3. Gain Ratio\n";
-    cout << "Enter choice (1-3): ";
-    
-    int metricChoice;
-    cin >> metricChoice;
-    
-    string metric;
-    if(metricChoice == 1) 
-        metric = "gini";
-    else if(metricChoice == 2) 
-        metric = "info";
-    else if(metricChoice == 3) 
-        metric = "gain";
-    else { 
-        cerr << "Invalid metric\n"; 
-        return 1; 
-    }
-
-    cout << "\nLoading data from: " << inputFile << endl;
-
-    vector<vector<string>> data = loadDataFile(inputFile);
-    vector<vector<string>> trainData, testData;
-    splitData(data, trainData, testData);   // 70% train / 30% test
-            
-    if(data.empty()) {
-        cerr << "No data loaded!\n";
-        return 1;
-    }
-        
-    cout << "Loaded " << data.size() << " samples with " << data[0].size() << " attributes\n";
-    cout << "Target attribute: " << labelName << " (column " << labelIndex << ")\n";
-
-    // Display attribute names
-    cout << "\nAttributes:\n";
-    for(int i = 0; i < attributeNames.size(); i++) {
-        if(i == labelIndex) {
-            cout << "  [" << i << "] " << attributeNames[i] << " (TARGET)\n";
-        } else {
-            cout << "  [" << i << "] " << attributeNames[i] << "\n";
-        }
-    }
-
-    vector<int> featureIndices;
-    for(int i = 0; i < (int)data[0].size(); i++) {
-        if(i != labelIndex) {
-            featureIndices.push_back(i);
-        }
-    }
-    auto start = chrono::high_resolution_clock::now();
-
-    Node* tree = buildTree(trainData, featureIndices, labelIndex, metric, attributeNames);
-
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
-
-    double testAcc  = calculateAccuracy(tree, testData, labelIndex);
-
-    cout << "\nTree Building Time: " << duration.count() / 1000.0 << " seconds" << endl;
-    cout << "Validation Accuracy: " << testAcc << "%\n";
-    
-
-    ofstream outFile("predictions.txt");
-    if(!outFile) {
-        cerr << "Error opening predictions.txt for writing\n";
-    } else {
-        outFile << "SampleID,Actual,Predicted\n";
-        for(int i = 0; i < (int)data.size(); i++) {
-            string pred = predict(tree, data[i]);
-            string actual = data[i][labelIndex];
-            outFile << (i+1) << "," << actual << "," << pred << "\n";
-        }
-        outFile.close();
-        cout << "\nAll predictions saved to predictions.txt\n";
-    }
-    delete tree;
-    return 0;
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string_view>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <cstdlib>
+#include <cstdio>
+#include <charconv>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1 //AVX2 kernels are compiled with a target attribute and picked at run time
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <csignal>
+#include <cerrno>
+#include <sys/wait.h>
+#define HAVE_MMAP 1
+#define HAVE_FORK 1 //bench runs each dataset and metric in a child process to measure its peak rss
+#define HAVE_UNIX_SOCKETS 1 //the serve subcommand
+#else
+#include <filesystem> //temporary files
+#endif
+
+using namespace std;
+
+const uint32_t UNKNOWN_CODE = UINT32_MAX; //code used for the "unknown" label and for values that have no code
+
+//Profiling
+//counters and phase timers that show where a training run spends its time
+//everything is off until profiler.enable() is called; a disabled hook is one relaxed load and a branch
+enum ProfileCounter { //totals kept for the whole run
+    CANDIDATES_SCORED, //splits scored by the criterion (every threshold of a numeric feature counts)
+    ROWS_SCANNED,      //row visits while scoring features and counting histograms
+    BYTES_ALLOCATED,   //arena blocks, presorted arrays and node histograms
+    NUM_PROFILE_COUNTERS
+};
+const char* const PROFILE_COUNTER_NAMES[NUM_PROFILE_COUNTERS] = {"candidate evaluations", "rows scanned", "bytes allocated"};
+const int PROFILE_MAX_DEPTH = 64; //deeper nodes are counted in the last slot
+
+struct TraceEvent { //one finished phase, times in microseconds since enable()
+    const char* name;
+    double start, duration;
+};
+
+struct PhaseTotal {
+    const char* name;
+    uint64_t calls;
+    double micros;
+};
+
+struct ThreadProfile { //what one thread recorded, only that thread writes to it
+    uint32_t thread; //number in the trace, in the order threads first recorded something
+    atomic<uint64_t> counters[NUM_PROFILE_COUNTERS];
+    atomic<uint64_t> nodesAtDepth[PROFILE_MAX_DEPTH];
+    vector<PhaseTotal> phases; //a handful of names, a linear search is fine
+    vector<TraceEvent> events;
+
+    explicit ThreadProfile(uint32_t id) : thread(id) {
+        for(auto& c : counters)
+            c.store(0, memory_order_relaxed);
+        for(auto& d : nodesAtDepth)
+            d.store(0, memory_order_relaxed);
+    }
+};
+
+class Profiler {
+public:
+    Profiler() : on(false), maxEvents(1 << 20) {}
+
+    void enable() {
+        origin = chrono::steady_clock::now();
+        on.store(true, memory_order_relaxed);
+    }
+    bool enabled() const { return on.load(memory_order_relaxed); }
+
+    double now() const { return chrono::duration<double, micro>(chrono::steady_clock::now() - origin).count(); }
+
+    void count(ProfileCounter counter, uint64_t amount) {
+        local().counters[counter].fetch_add(amount, memory_order_relaxed);
+    }
+
+    void node(int depth) {
+        local().nodesAtDepth[min(depth, PROFILE_MAX_DEPTH - 1)].fetch_add(1, memory_order_relaxed);
+    }
+
+    void phase(const char* name, double start, double end) {
+        ThreadProfile& mine = local();
+        PhaseTotal* total = nullptr;
+        for(PhaseTotal& p : mine.phases)
+            if(p.name == name || strcmp(p.name, name) == 0)
+                total = &p;
+        if(total == nullptr) {
+            mine.phases.push_back({name, 0, 0});
+            total = &mine.phases.back();
+        }
+        total->calls++;
+        total->micros += end - start;
+        if(mine.events.size() < maxEvents) //a huge tree would otherwise make an unloadable trace
+            mine.events.push_back({name, start, end - start});
+    }
+
+    //the report reads every thread's records, so it must run once the work has finished
+    void printSummary(ostream& out) {
+        lock_guard<mutex> lock(guard);
+        vector<PhaseTotal> phases;
+        uint64_t counters[NUM_PROFILE_COUNTERS] = {};
+        uint64_t depths[PROFILE_MAX_DEPTH] = {};
+        for(auto& profile : profiles) {
+            for(const PhaseTotal& p : profile->phases) {
+                auto same = find_if(phases.begin(), phases.end(), [&p](const PhaseTotal& q) { return strcmp(p.name, q.name) == 0; });
+                if(same == phases.end()) {
+                    phases.push_back(p);
+                } else {
+                    same->calls += p.calls;
+                    same->micros += p.micros;
+                }
+            }
+            for(int c = 0; c < NUM_PROFILE_COUNTERS; c++)
+                counters[c] += profile->counters[c].load(memory_order_relaxed);
+            for(int d = 0; d < PROFILE_MAX_DEPTH; d++)
+                depths[d] += profile->nodesAtDepth[d].load(memory_order_relaxed);
+        }
+
+        out << "\nPhase                  Calls   Total(ms)  (summed over " << profiles.size() << " threads)\n" << fixed << setprecision(3);
+        for(const PhaseTotal& p : phases)
+            out << left << setw(20) << p.name << right << setw(8) << p.calls << setw(12) << p.micros / 1000 << "\n";
+        out << "\nCounter                          Total\n";
+        for(int c = 0; c < NUM_PROFILE_COUNTERS; c++)
+            out << left << setw(24) << PROFILE_COUNTER_NAMES[c] << right << setw(14) << counters[c] << "\n";
+        out << "\nDepth   Nodes built\n";
+        for(int d = 0; d < PROFILE_MAX_DEPTH; d++)
+            if(depths[d] > 0)
+                out << setw(5) << d << setw(14) << depths[d] << "\n";
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+    }
+
+    //chrome trace event format, open it in chrome://tracing or ui.perfetto.dev
+    bool writeTrace(const string& filename) {
+        lock_guard<mutex> lock(guard);
+        ofstream out(filename);
+        if(!out)
+            return false;
+        out << "{\"traceEvents\":[\n" << fixed << setprecision(3);
+        bool first = true;
+        for(auto& profile : profiles) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << profile->thread
+                << ",\"args\":{\"name\":\"thread " << profile->thread << "\"}}";
+            first = false;
+            for(const TraceEvent& e : profile->events)
+                out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"train\",\"ph\":\"X\",\"pid\":1,\"tid\":" << profile->thread
+                    << ",\"ts\":" << e.start << ",\"dur\":" << e.duration << "}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return (bool)out;
+    }
+
+private:
+    ThreadProfile& local() { //each thread registers once and then only touches its own record
+        thread_local ThreadProfile* mine = nullptr;
+        if(mine == nullptr) {
+            lock_guard<mutex> lock(guard);
+            profiles.emplace_back(new ThreadProfile((uint32_t)profiles.size()));
+            mine = profiles.back().get(); //records outlive their threads so pool workers can exit before the report
+        }
+        return *mine;
+    }
+
+    atomic<bool> on;
+    size_t maxEvents; //per thread
+    chrono::steady_clock::time_point origin;
+    mutex guard;
+    vector<unique_ptr<ThreadProfile>> profiles;
+};
+
+Profiler profiler; //one per process, threads find their record through a thread_local
+
+inline void profileCount(ProfileCounter counter, uint64_t amount = 1) {
+    if(profiler.enabled())
+        profiler.count(counter, amount);
+}
+
+inline void profileNode(int depth) {
+    if(profiler.enabled())
+        profiler.node(depth);
+}
+
+struct ProfilePhase { //times the enclosing scope as one phase on the calling thread
+    const char* name; //must be a string literal, only the pointer is kept
+    double start;
+
+    explicit ProfilePhase(const char* phaseName) : name(phaseName), start(profiler.enabled() ? profiler.now() : -1) {}
+    ~ProfilePhase() { finish(); }
+
+    void finish() { //ends the phase before the scope does
+        if(start >= 0)
+            profiler.phase(name, start, profiler.now());
+        start = -1;
+    }
+    ProfilePhase(const ProfilePhase&) = delete;
+    ProfilePhase& operator=(const ProfilePhase&) = delete;
+};
+
+struct Column { //one column of the dataset, every cell is stored as a dense integer code or as a number
+    bool numeric;            //true if every value in the column is a number (then only numbers is filled)
+    vector<uint32_t> codes;  //code of the cell in every row (contiguous, one entry per row)
+    vector<string> values;   //code -> original string, only needed when printing results
+    vector<float> numbers;   //value of the cell in every row for numeric columns, NaN for a missing value
+    vector<uint8_t> bins;    //histogram mode: bin of every row of a numeric column, missing values use bin numBins()
+    vector<float> binUpper;  //histogram mode: largest value that falls in each bin (the last one is +inf)
+
+    Column() : numeric(false) {}
+
+    uint32_t numBins() const { return (uint32_t)binUpper.size(); } //bins for real values, one more is used for missing values
+
+    uint32_t cardinality() const { //number of distinct values in the column
+        return (uint32_t)values.size();
+    }
+};
+
+struct Dataset { //columnar dataset, each column is dictionary encoded once at load time
+    vector<Column> columns;
+    size_t numRows;
+
+    Dataset() : numRows(0) {}
+
+    bool empty() const { return numRows == 0; }
+    size_t size() const { return numRows; }
+
+    uint32_t code(uint32_t row, int column) const { //encoded value of one cell
+        return columns[column].codes[row];
+    }
+
+    float number(uint32_t row, int column) const { //value of one cell of a numeric column
+        return columns[column].numbers[row];
+    }
+
+    const string& decode(int column, uint32_t code) const { //turn a code back into the original string for output
+        static const string unknown = "unknown";
+        if(code == UNKNOWN_CODE || code >= columns[column].values.size())
+            return unknown;
+        return columns[column].values[code];
+    }
+};
+
+//bump allocator that owns every node and child table of a tree
+//memory comes from blocks that double in size (up to 1 MB), nothing is freed one object at a time,
+//and destroying the arena releases the whole tree by freeing its handful of blocks
+//only trivially destructible objects may live here since no destructor is ever run
+class NodeArena {
+public:
+    NodeArena() : current(nullptr), used(0), capacity(0), nextBlockSize(4096), bytes(0) {}
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    void* allocate(size_t size, size_t align) { //thread safe, the parallel build allocates from several tasks
+        lock_guard<mutex> lock(guard);
+        size_t offset = (used + align - 1) & ~(align - 1);
+        if(current == nullptr || offset + size > capacity) {
+            size_t blockSize = max(nextBlockSize, size + align);
+            blocks.emplace_back(new char[blockSize]);
+            current = blocks.back().get();
+            capacity = blockSize;
+            bytes += blockSize;
+            profileCount(BYTES_ALLOCATED, blockSize);
+            nextBlockSize = min<size_t>(nextBlockSize * 2, 1 << 20);
+            offset = ((uintptr_t)current + align - 1) & ~(uintptr_t)(align - 1);
+            offset -= (uintptr_t)current;
+        }
+        used = offset + size;
+        return current + offset;
+    }
+
+    template <typename T>
+    T* make() { return new (allocate(sizeof(T), alignof(T))) T(); }
+
+    template <typename T>
+    T* makeArray(size_t count) { //value initialized, so pointers start out null
+        T* array = (T*)allocate(max<size_t>(1, count) * sizeof(T), alignof(T));
+        for(size_t i = 0; i < count; i++)
+            new (array + i) T();
+        return array;
+    }
+
+    const char* copyString(const string& text) {
+        char* copy = makeArray<char>(text.size() + 1);
+        memcpy(copy, text.c_str(), text.size() + 1);
+        return copy;
+    }
+
+    size_t bytesReserved() const { return bytes; }
+
+private:
+    mutex guard;
+    vector<unique_ptr<char[]>> blocks;
+    char* current;
+    size_t used;
+    size_t capacity;
+    size_t nextBlockSize;
+    size_t bytes;
+};
+
+struct Node {
+    const char* featureName; //name of feature used for splitting (stored in the tree's arena)
+    int featureIndex;  //column index of that feature in the data
+    uint32_t label;    //label code if the node is a leaf (decode it with the label column's dictionary),
+                       //for a split node the fallback label once pruning has fixed it (UNKNOWN_CODE = take it from the children)
+    bool isLeaf;       //true if this node is a leaf node (if it is a leaf then that node stores the final answer)
+    bool numeric;      //true if the node splits a numeric feature on a threshold
+    float threshold;   //numeric split: value <= threshold follows child 0, anything else (including missing) child 1
+    Node** children;   //dense child table indexed by feature value code (0/1 for a numeric split) so that the tree knows which branch to follow,
+                       //null where no training row had that value
+    uint32_t numChildren; //entries in children, one past the largest code that has a child
+    int* classCounts;  //training rows of each label code that reached this node, filled by buildTree so pruning never
+                       //rescans the rows (null for trees grown some other way)
+    
+    Node() : featureName(""), featureIndex(-1), label(UNKNOWN_CODE), isLeaf(false), numeric(false), threshold(0.0f),
+             children(nullptr), numChildren(0), classCounts(nullptr) {} //constructor that runs when a new node is created
+                                                //It sets the featureIndex = -1 and sets isLeaf = false (assuming it's not a leaf at first)
+
+    Node* child(uint32_t code) const { return code < numChildren ? children[code] : nullptr; }
+};
+static_assert(is_trivially_destructible<Node>::value, "nodes live in a NodeArena and are never destroyed one by one");
+
+//a trained tree and the arena its nodes live in; moving it is cheap and destroying it frees everything at once
+struct DecisionTree {
+    unique_ptr<NodeArena> arena;
+    Node* root;
+
+    DecisionTree() : arena(new NodeArena()), root(nullptr) {}
+};
+
+const uint32_t DEFAULT_SEED = 42; //every shuffle is seeded so runs can be repeated
+
+//row numbers of every class, each list shuffled with the seed
+vector<vector<uint32_t>> shuffledClassRows(const Dataset& data, int labelIndex, uint32_t seed) {
+    vector<vector<uint32_t>> byClass(data.columns[labelIndex].values.size());
+    const uint32_t* labels = data.columns[labelIndex].codes.data();
+    for(uint32_t r = 0; r < (uint32_t)data.size(); r++)
+        byClass[labels[r]].push_back(r);
+    mt19937 g(seed);
+    for(auto& rows : byClass)
+        shuffle(rows.begin(), rows.end(), g);
+    return byClass;
+}
+
+//holdout split that keeps the class proportions: every class sends trainRatio of its rows to training
+void stratifiedSplit(const Dataset& data, int labelIndex, vector<uint32_t>& trainRows, vector<uint32_t>& testRows,
+                     double trainRatio = 0.7, uint32_t seed = DEFAULT_SEED) {
+    for(const auto& rows : shuffledClassRows(data, labelIndex, seed)) {
+        size_t trainSize = (size_t)(rows.size() * trainRatio + 0.5);
+        trainRows.insert(trainRows.end(), rows.begin(), rows.begin() + trainSize);
+        testRows.insert(testRows.end(), rows.begin() + trainSize, rows.end());
+    }
+}
+
+//splits the rows into k folds of (almost) equal size, dealing every class out in turn so each fold gets its share
+vector<vector<uint32_t>> stratifiedFolds(const Dataset& data, int labelIndex, int k, uint32_t seed = DEFAULT_SEED) {
+    vector<vector<uint32_t>> folds(k);
+    size_t next = 0; //the deal continues across classes so the fold sizes differ by at most one
+    for(const auto& rows : shuffledClassRows(data, labelIndex, seed)) {
+        for(uint32_t r : rows)
+            folds[next++ % k].push_back(r);
+    }
+    return folds;
+}
+
+void sortDictionary(Column& column) { //renumber the codes so they follow the string order of the values
+                                      //this keeps tie breaking the same as when the tree was built on strings
+    vector<uint32_t> order(column.values.size());
+    for(uint32_t i = 0; i < (uint32_t)order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return column.values[a] < column.values[b];
+    });
+
+    vector<uint32_t> remap(order.size()); //old code -> new code
+    vector<string> sortedValues(order.size());
+    for(uint32_t i = 0; i < (uint32_t)order.size(); i++) {
+        remap[order[i]] = i;
+        sortedValues[i] = move(column.values[order[i]]);
+    }
+    for(auto& c : column.codes)
+        c = remap[c];
+    column.values = move(sortedValues);
+}
+
+float midpoint(float low, float high) { //threshold halfway between two neighbouring values, never equal to high
+    float mid = low + (high - low) / 2;
+    return mid < high ? mid : low;
+}
+
+bool parseNumber(const string& text, float& value) { //true if the whole string is a number
+    if(text.empty())
+        return false;
+    char* stop = nullptr;
+    double parsed = strtod(text.c_str(), &stop);
+    if(*stop != '\0' || std::isnan(parsed))
+        return false;
+    value = (float)parsed;
+    return true;
+}
+
+bool isMissing(const string& text) { //empty cells and "?" mark missing values in the UCI files
+    return text.empty() || text == "?";
+}
+
+enum ColumnType { //type a schema gives a column, AUTO leaves it to detectColumnType
+    AUTO_COLUMN,
+    NUMERIC_COLUMN,
+    CATEGORICAL_COLUMN
+};
+
+//a column becomes numeric if every distinct value is a number or missing (and at least one is a number)
+//the check only looks at the dictionary, so it costs one parse per distinct value and not per row
+void detectColumnType(Column& column) {
+    vector<float> parsed(column.values.size(), numeric_limits<float>::quiet_NaN());
+    bool anyNumber = false;
+    for(size_t code = 0; code < column.values.size(); code++) {
+        if(parseNumber(column.values[code], parsed[code]))
+            anyNumber = true;
+        else if(!isMissing(column.values[code]))
+            return; //a non numeric value means the column stays categorical
+    }
+    if(!anyNumber)
+        return;
+
+    column.numeric = true;
+    column.numbers.resize(column.codes.size());
+    for(size_t r = 0; r < column.codes.size(); r++)
+        column.numbers[r] = parsed[column.codes[r]];
+    vector<uint32_t>().swap(column.codes); //numeric columns keep only the numbers
+    vector<string>().swap(column.values);
+}
+
+bool forceNumeric(Column& column) { //a column the schema declares numeric, false if a value is not a number
+    vector<float> parsed(column.values.size(), numeric_limits<float>::quiet_NaN());
+    for(size_t code = 0; code < column.values.size(); code++) {
+        if(!parseNumber(column.values[code], parsed[code]) && !isMissing(column.values[code]))
+            return false;
+    }
+    column.numeric = true; //even if every value is missing
+    column.numbers.resize(column.codes.size());
+    for(size_t r = 0; r < column.codes.size(); r++)
+        column.numbers[r] = parsed[column.codes[r]];
+    vector<uint32_t>().swap(column.codes);
+    vector<string>().swap(column.values);
+    return true;
+}
+
+class MappedFile { //read only view of a whole file, memory mapped where the platform has mmap
+public:
+    MappedFile() : text(nullptr), length(0), mapped(false) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef HAVE_MMAP
+        if(mapped)
+            munmap((void*)text, length);
+#endif
+    }
+
+    bool open(const string& filename) {
+#ifdef HAVE_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat info;
+        if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(address != MAP_FAILED) {
+                madvise(address, (size_t)info.st_size, MADV_SEQUENTIAL);
+                text = (const char*)address;
+                length = (size_t)info.st_size;
+                mapped = true;
+                close(fd);
+                return true;
+            }
+        }
+        close(fd);
+#endif
+        ifstream file(filename, ios::binary); //no mmap (or an empty or special file): read it into memory instead
+        if(!file)
+            return false;
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        text = buffer.data();
+        length = buffer.size();
+        return true;
+    }
+
+    const char* data() const { return text; }
+    size_t size() const { return length; }
+
+private:
+    const char* text;
+    size_t length;
+    bool mapped;
+    string buffer;
+};
+
+string_view trimCell(string_view cell) { //strip the same whitespace the loader has always trimmed
+    size_t first = cell.find_first_not_of(" \t\r\n");
+    if(first == string_view::npos)
+        return string_view();
+    size_t last = cell.find_last_not_of(" \t\r\n");
+    return cell.substr(first, last - first + 1);
+}
+
+struct ParsedChunk { //cells of one block of lines, encoded against the chunk's own dictionaries
+    size_t numRows;
+    vector<vector<uint32_t>> codes;     //column -> local code of every row in the chunk
+    vector<vector<string_view>> values; //column -> local code -> text inside the file
+    vector<unordered_map<string_view, uint32_t>> lookup;
+
+    ParsedChunk() : numRows(0) {}
+
+    uint32_t encode(size_t col, string_view value) {
+        auto inserted = lookup[col].emplace(value, (uint32_t)values[col].size());
+        if(inserted.second)
+            values[col].push_back(value);
+        return inserted.first->second;
+    }
+
+    void addColumn() { //a row wider than the ones before it adds a new column
+        codes.emplace_back();
+        values.emplace_back();
+        lookup.emplace_back();
+        if(numRows > 0) //earlier rows had no cell here, the first row of a chunk must not add an empty value
+            codes.back().assign(numRows, encode(codes.size() - 1, string_view()));
+    }
+};
+
+//tokenizes the lines in text[begin,end) (begin is a line start) without making a string per cell
+//cells follow getline: split on the delimiter, no extra empty cell after a trailing delimiter,
+//whitespace trimmed but empty cells kept, and blank lines skipped
+void parseLines(const char* text, size_t begin, size_t end, char delimiter, ParsedChunk& chunk) {
+    ProfilePhase phase("parse");
+    size_t pos = begin;
+    while(pos < end) {
+        const char* newline = (const char*)memchr(text + pos, '\n', end - pos);
+        size_t lineEnd = newline ? (size_t)(newline - text) : end;
+        string_view line(text + pos, lineEnd - pos);
+        pos = lineEnd + 1;
+
+        if(line.find_first_not_of(" \t\r\n") == string_view::npos) //skip empty or whitespace only lines
+            continue;
+
+        size_t col = 0;
+        size_t start = 0;
+        while(start < line.size()) {
+            size_t stop = line.find(delimiter, start);
+            if(stop == string_view::npos)
+                stop = line.size();
+            if(col == chunk.codes.size())
+                chunk.addColumn();
+            chunk.codes[col].push_back(chunk.encode(col, trimCell(line.substr(start, stop - start))));
+            col++;
+            start = stop + 1;
+        }
+        for(; col < chunk.codes.size(); col++) //a shorter row gets empty cells for the missing columns
+            chunk.codes[col].push_back(chunk.encode(col, string_view()));
+        chunk.numRows++;
+    }
+}
+
+//labelIndex is the target column, it is always kept categorical even if its values look like numbers
+//the file is memory mapped and cut into one block of whole lines per thread; each thread dictionary encodes
+//its block, then each column's block dictionaries are merged into the column's dictionary
+//hasHeader skips the first line (read it with readHeader), types forces the type of some columns (missing entries are AUTO_COLUMN)
+Dataset loadDataFile(const string& filename, char delimiter=',', int labelIndex=-1, int threads=0,
+                     bool hasHeader=false, const vector<ColumnType>& types = vector<ColumnType>()) {
+    ProfilePhase phase("load");
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "Error opening file: " << filename << endl;
+        exit(1);
+    }
+    const char* text = file.data();
+    size_t size = file.size();
+
+    if(threads <= 0)
+        threads = max(1, (int)thread::hardware_concurrency());
+    const size_t minChunkBytes = 1 << 20; //small files are not worth the threads
+    size_t numChunks = max<size_t>(1, min<size_t>((size_t)threads, size / minChunkBytes));
+
+    vector<size_t> bounds(numChunks + 1, size); //chunk k covers text[bounds[k], bounds[k+1])
+    bounds[0] = 0;
+    if(hasHeader) { //data starts on the second line
+        const char* newline = (const char*)memchr(text, '\n', size);
+        bounds[0] = newline ? (size_t)(newline - text) + 1 : size;
+    }
+    for(size_t k = 1; k < numChunks; k++) { //move every cut forward to the start of the next line
+        size_t pos = max(bounds[k - 1], size * k / numChunks);
+        if(pos > 0 && text[pos - 1] != '\n') {
+            const char* newline = (const char*)memchr(text + pos, '\n', size - pos);
+            pos = newline ? (size_t)(newline - text) + 1 : size;
+        }
+        bounds[k] = pos;
+    }
+
+    vector<ParsedChunk> chunks(numChunks);
+    vector<thread> workers;
+    for(size_t k = 1; k < numChunks; k++)
+        workers.emplace_back([&, k] { parseLines(text, bounds[k], bounds[k + 1], delimiter, chunks[k]); });
+    parseLines(text, bounds[0], bounds[1], delimiter, chunks[0]);
+    for(auto& w : workers)
+        w.join();
+    workers.clear();
+
+    Dataset data;
+    size_t numColumns = 0;
+    for(auto& chunk : chunks) {
+        data.numRows += chunk.numRows;
+        numColumns = max(numColumns, chunk.codes.size());
+    }
+    data.columns.resize(numColumns);
+    vector<char> notNumeric(numColumns, 0); //columns declared numeric that hold something else
+
+    auto mergeColumn = [&](size_t col) { //one dictionary per column, rows stay in file order
+        ProfilePhase phase("merge column");
+        Column& column = data.columns[col];
+        column.codes.resize(data.numRows);
+        unordered_map<string_view, uint32_t> lookup;
+        vector<string_view> values;
+        auto encode = [&](string_view value) {
+            auto inserted = lookup.emplace(value, (uint32_t)values.size());
+            if(inserted.second)
+                values.push_back(value);
+            return inserted.first->second;
+        };
+        uint32_t* out = column.codes.data();
+        for(auto& chunk : chunks) {
+            if(col < chunk.codes.size()) {
+                vector<uint32_t> remap(chunk.values[col].size()); //chunk code -> column code
+                for(size_t local = 0; local < remap.size(); local++)
+                    remap[local] = encode(chunk.values[col][local]);
+                for(uint32_t local : chunk.codes[col])
+                    *out++ = remap[local];
+            } else if(chunk.numRows > 0) { //every line in this chunk was narrower than the column
+                out = fill_n(out, chunk.numRows, encode(string_view()));
+            }
+        }
+        column.values.assign(values.begin(), values.end()); //one string per distinct value
+        sortDictionary(column);
+        ColumnType type = col < types.size() ? types[col] : AUTO_COLUMN;
+        if((int)col == labelIndex || type == CATEGORICAL_COLUMN)
+            return;
+        if(type == AUTO_COLUMN)
+            detectColumnType(column);
+        else if(!forceNumeric(column))
+            notNumeric[col] = 1;
+    };
+    size_t numWorkers = max<size_t>(1, min<size_t>((size_t)threads, numColumns));
+    for(size_t w = 1; w < numWorkers; w++) { //columns are merged independently, spread them over the threads
+        workers.emplace_back([&, w] {
+            for(size_t col = w; col < numColumns; col += numWorkers)
+                mergeColumn(col);
+        });
+    }
+    for(size_t col = 0; col < numColumns; col += numWorkers)
+        mergeColumn(col);
+    for(auto& w : workers)
+        w.join();
+    for(size_t col = 0; col < numColumns; col++) {
+        if(notNumeric[col]) {
+            cerr << "Column " << col << " of " << filename << " is declared numeric but holds text values\n";
+            exit(1);
+        }
+    }
+
+    return data;
+}
+
+vector<string> readHeader(const string& filename, char delimiter=',') { //column names from the first line
+    ifstream file(filename);
+    string line;
+    vector<string> names;
+    if(!getline(file, line))
+        return names;
+    string_view rest(line);
+    while(true) {
+        size_t cut = rest.find(delimiter);
+        names.emplace_back(trimCell(rest.substr(0, cut)));
+        if(cut == string_view::npos)
+            break;
+        rest.remove_prefix(cut + 1);
+    }
+    return names;
+}
+
+//upper bounds of the bins over the sorted distinct values of a column, counts[i] rows having distinct[i] out of total
+vector<float> binBoundaries(const vector<float>& distinct, const vector<size_t>& counts, size_t total, int maxBins) {
+    vector<float> binUpper;
+    size_t seen = 0;
+    for(size_t i = 0; i + 1 < distinct.size(); i++) {
+        seen += counts[i];
+        bool cut = distinct.size() <= (size_t)maxBins //few values: every value gets its own bin
+                   || seen * maxBins >= total * (binUpper.size() + 1); //otherwise cut every total/maxBins rows
+        if(cut && (int)binUpper.size() + 1 < maxBins)
+            binUpper.push_back(midpoint(distinct[i], distinct[i + 1]));
+    }
+    binUpper.push_back(numeric_limits<float>::infinity());
+    return binUpper;
+}
+
+//quantizes a numeric column into at most maxBins bins of roughly equal row counts (one bin per value if there are few values)
+//a value x falls in the first bin whose upper bound is >= x, so "bin <= b" is the same test as "x <= binUpper[b]"
+void binColumn(Column& column, int maxBins) {
+    vector<float> sorted; //every non missing value, sorted
+    sorted.reserve(column.numbers.size());
+    for(float x : column.numbers)
+        if(!std::isnan(x))
+            sorted.push_back(x);
+    sort(sorted.begin(), sorted.end());
+
+    vector<float> distinct; //distinct values and how many rows have each
+    vector<size_t> counts;
+    for(float x : sorted) {
+        if(distinct.empty() || distinct.back() != x) {
+            distinct.push_back(x);
+            counts.push_back(0);
+        }
+        counts.back()++;
+    }
+
+    column.binUpper = binBoundaries(distinct, counts, sorted.size(), maxBins);
+
+    column.bins.resize(column.numbers.size());
+    for(size_t r = 0; r < column.numbers.size(); r++) {
+        float x = column.numbers[r];
+        column.bins[r] = std::isnan(x) ? (uint8_t)column.numBins()
+                                       : (uint8_t)(lower_bound(column.binUpper.begin(), column.binUpper.end(), x) - column.binUpper.begin());
+    }
+}
+
+//histogram training mode: quantize every numeric column to uint8_t bins right after loading
+void binNumericColumns(Dataset& data, int maxBins = 255) { //255 value bins plus the missing bin fit in a uint8_t
+    for(auto& column : data.columns) {
+        if(column.numeric)
+            binColumn(column, maxBins);
+    }
+}
+
+//reorders rows[begin,end) in place so the rows are grouped by their branch (like the partition step of quicksort)
+//branchOf[r] is the branch of row r, for a categorical split that is simply the feature's code column
+//returns the group boundaries: rows in branch b end up in [offsets[b], offsets[b+1])
+vector<size_t> partitionRows(vector<uint32_t>& rows, size_t begin, size_t end, const uint32_t* branchOf, uint32_t numBranches) {
+    vector<size_t> offsets(numBranches + 1, 0); //start of each group
+    for(size_t i = begin; i < end; i++)
+        offsets[branchOf[rows[i]] + 1]++;
+    offsets[0] = begin;
+    for(uint32_t b = 0; b < numBranches; b++)
+        offsets[b + 1] += offsets[b];
+
+    vector<size_t> next(offsets.begin(), offsets.end() - 1); //next free slot in each group
+    for(uint32_t b = 0; b < numBranches; b++) { //fill each group in turn, swapping rows that belong elsewhere into their own group
+        while(next[b] < offsets[b + 1]) {
+            uint32_t target = branchOf[rows[next[b]]];
+            if(target == b)
+                next[b]++;
+            else
+                swap(rows[next[b]], rows[next[target]++]);
+        }
+    }
+    return offsets;
+}
+
+//same grouping as partitionRows but keeps the order of the rows inside each group
+//used for the presorted arrays of the numeric features, which must stay sorted in every child
+//scratch is a buffer as long as the rows array, only [begin,end) of it is touched
+void stablePartitionRows(vector<uint32_t>& rows, size_t begin, size_t end, const uint32_t* branchOf,
+                         const vector<size_t>& offsets, vector<uint32_t>& scratch) {
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for(size_t i = begin; i < end; i++)
+        scratch[next[branchOf[rows[i]]]++] = rows[i];
+    copy(scratch.begin() + begin, scratch.begin() + end, rows.begin() + begin);
+}
+
+//(feature value x class) contingency table for one candidate feature at one node
+//it is filled in a single pass over the node's rows and every split criterion is computed from it
+//the counts live in one flat array, one row of numClasses counts per feature value
+struct CountTable {
+    uint32_t numValues;  //cardinality of the feature column
+    uint32_t numClasses; //cardinality of the label column
+    int total;           //number of rows counted
+    vector<int> counts;  //counts[value * numClasses + class]
+    vector<int> valueTotals; //rows with each feature value
+    vector<int> classTotals; //rows with each class label
+
+    CountTable() : numValues(0), numClasses(0), total(0) {}
+
+    void reset(uint32_t values, uint32_t classes, int rowsCounted) { //zero a values x classes table, reusing the arrays
+        numValues = values;
+        numClasses = classes;
+        total = rowsCounted;
+        counts.assign((size_t)values * classes, 0);
+        valueTotals.assign(values, 0);
+        classTotals.assign(classes, 0);
+    }
+
+    const int* row(uint32_t value) const { return counts.data() + (size_t)value * numClasses; } //class counts of one feature value
+
+    void addMargins() { //sum the value and class totals from the counts
+        for(uint32_t v = 0; v < numValues; v++) {
+            const int* classCounts = row(v);
+            for(uint32_t c = 0; c < numClasses; c++) {
+                valueTotals[v] += classCounts[c];
+                classTotals[c] += classCounts[c];
+            }
+        }
+    }
+
+    void load(const int* cells, uint32_t values, uint32_t classes) { //take the counts from a histogram slice instead of the rows
+        reset(values, classes, 0);
+        copy(cells, cells + counts.size(), counts.begin());
+        addMargins();
+        for(int t : valueTotals)
+            total += t;
+    }
+
+    void fill(const Dataset& data, const vector<uint32_t>& rows, size_t begin, size_t end,
+              int featureIndex, int labelIndex) { //count the rows in [begin,end), reusing the arrays from the last fill
+        reset(data.columns[featureIndex].cardinality(), data.columns[labelIndex].cardinality(), (int)(end - begin));
+
+        const uint32_t* codes = data.columns[featureIndex].codes.data();
+        const uint32_t* labels = data.columns[labelIndex].codes.data();
+        int* cells = counts.data();
+        for(size_t i = begin; i < end; i++) { //the only pass over the rows
+            uint32_t r = rows[i];
+            cells[(size_t)codes[r] * numClasses + labels[r]]++;
+        }
+
+        addMargins(); //the margins are summed from the table, not from the rows
+    }
+};
+
+//Criterion kernels
+//entropy and gini straight from integer counts: with N = sum of n_i,
+//    entropy = (N log2 N - sum n_i log2 n_i) / N        gini = 1 - (sum n_i^2) / N^2
+//so the only logs are n log2 n terms, which come from a table for small n, and the class sums are reductions with an AVX2 version
+//both versions add the terms in the same order (8 lanes, then the lanes pairwise, then the leftovers), so they give the same
+//bits and a tree does not depend on the CPU it was trained on
+//against the textbook -sum p log2 p and 1 - sum p^2 the results agree to within CRITERION_TOLERANCE (absolute) for any node
+//of up to 2^31 rows; decisiontree test checks this (checkCriterionKernels), over seeds 1 to 5 the largest error
+//it measured was 1.2e-14 for entropy and 1.2e-15 for gini, and the AVX2 sums matched the scalar ones bit for bit
+const double CRITERION_TOLERANCE = 1e-12;
+const int NLOGN_TABLE_SIZE = 1 << 12; //32 KB of doubles, counts at or above this call log2
+
+bool detectAvx2() {
+#ifdef HAVE_AVX2_KERNELS
+    __builtin_cpu_init(); //we run before main, so the cpu model has to be set up by hand
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+const bool cpuHasAvx2 = detectAvx2(); //asked once at startup, the criterion and batch prediction kernels only read this
+
+struct NLogNTable {
+    double values[NLOGN_TABLE_SIZE]; //values[n] = n log2 n, 0 for n = 0
+
+    NLogNTable() {
+        values[0] = 0.0;
+        for(int n = 1; n < NLOGN_TABLE_SIZE; n++)
+            values[n] = n * log2((double)n);
+    }
+};
+
+const NLogNTable nlognTable;
+
+inline double nlogn(int n) {
+    return n < NLOGN_TABLE_SIZE ? nlognTable.values[n] : n * log2((double)n);
+}
+
+inline double combineLanes(const double* lanes) { //the fixed order both kernels finish in
+    double s0 = lanes[0] + lanes[4], s1 = lanes[1] + lanes[5], s2 = lanes[2] + lanes[6], s3 = lanes[3] + lanes[7];
+    return (s0 + s1) + (s2 + s3);
+}
+
+inline double sumNLogNScalar(const int* counts, size_t n) { //sum of n_i log2 n_i
+    if(n < 8) { //no full block: the lanes would all be 0, so this is the same sum
+        double sum = 0.0;
+        for(size_t i = 0; i < n; i++)
+            sum += nlogn(counts[i]);
+        return sum;
+    }
+    double lanes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        for(int l = 0; l < 8; l++)
+            lanes[l] += nlogn(counts[i + l]);
+    double sum = combineLanes(lanes);
+    for(; i < n; i++)
+        sum += nlogn(counts[i]);
+    return sum;
+}
+
+inline double sumSquaresScalar(const int* counts, size_t n) { //sum of n_i^2, exact while it stays below 2^53
+    if(n < 8) {
+        double sum = 0.0;
+        for(size_t i = 0; i < n; i++)
+            sum += (double)counts[i] * counts[i];
+        return sum;
+    }
+    double lanes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        for(int l = 0; l < 8; l++)
+            lanes[l] += (double)counts[i + l] * counts[i + l];
+    double sum = combineLanes(lanes);
+    for(; i < n; i++)
+        sum += (double)counts[i] * counts[i];
+    return sum;
+}
+
+#ifdef HAVE_AVX2_KERNELS
+//8 counts per step: the table entries are gathered, a block with a count past the table is filled in with scalar logs
+__attribute__((target("avx2")))
+double sumNLogNAvx2(const int* counts, size_t n) {
+    __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd(); //lanes 0-3 and 4-7
+    const __m256i lastEntry = _mm256_set1_epi32(NLOGN_TABLE_SIZE - 1);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(counts + i));
+        if(_mm256_movemask_epi8(_mm256_cmpgt_epi32(block, lastEntry)) == 0) {
+            const __m256d zero = _mm256_setzero_pd(), all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); //masked form, the plain gather warns about its unset source
+            low = _mm256_add_pd(low, _mm256_mask_i32gather_pd(zero, nlognTable.values, _mm256_castsi256_si128(block), all, 8));
+            high = _mm256_add_pd(high, _mm256_mask_i32gather_pd(zero, nlognTable.values, _mm256_extracti128_si256(block, 1), all, 8));
+        } else {
+            double terms[8];
+            for(int l = 0; l < 8; l++)
+                terms[l] = nlogn(counts[i + l]);
+            low = _mm256_add_pd(low, _mm256_loadu_pd(terms));
+            high = _mm256_add_pd(high, _mm256_loadu_pd(terms + 4));
+        }
+    }
+    double lanes[8];
+    _mm256_storeu_pd(lanes, low);
+    _mm256_storeu_pd(lanes + 4, high);
+    _mm256_zeroupper();
+    double sum = combineLanes(lanes);
+    for(; i < n; i++)
+        sum += nlogn(counts[i]);
+    return sum;
+}
+
+__attribute__((target("avx2")))
+double sumSquaresAvx2(const int* counts, size_t n) {
+    __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(counts + i));
+        __m256d a = _mm256_cvtepi32_pd(_mm256_castsi256_si128(block));
+        __m256d b = _mm256_cvtepi32_pd(_mm256_extracti128_si256(block, 1));
+        low = _mm256_add_pd(low, _mm256_mul_pd(a, a));
+        high = _mm256_add_pd(high, _mm256_mul_pd(b, b));
+    }
+    double lanes[8];
+    _mm256_storeu_pd(lanes, low);
+    _mm256_storeu_pd(lanes + 4, high);
+    _mm256_zeroupper();
+    double sum = combineLanes(lanes);
+    for(; i < n; i++)
+        sum += (double)counts[i] * counts[i];
+    return sum;
+}
+#endif
+
+inline double sumNLogN(const int* counts, size_t n) {
+#ifdef HAVE_AVX2_KERNELS
+    if(n >= 8 && cpuHasAvx2) //fewer classes than one vector are not worth the switch
+        return sumNLogNAvx2(counts, n);
+#endif
+    return sumNLogNScalar(counts, n);
+}
+
+inline double sumSquares(const int* counts, size_t n) {
+#ifdef HAVE_AVX2_KERNELS
+    if(n >= 8 && cpuHasAvx2)
+        return sumSquaresAvx2(counts, n);
+#endif
+    return sumSquaresScalar(counts, n);
+}
+
+double giniFromCounts(const int* counts, size_t n, int total) { //gini impurity of a set given how many samples are in each class
+    if(total == 0)
+        return 0.0;
+    return 1.0 - sumSquares(counts, n) / ((double)total * total); //1 - sum of the squared class shares
+}
+
+double entropyFromCounts(const int* counts, size_t n, int total) { //entropy of a set given how many samples have each value
+    if(total == 0)
+        return 0.0;
+    return (nlogn(total) - sumNLogN(counts, n)) / total; //same as -sum p log2 p with p = count/total, empty classes add 0
+}
+
+uint32_t majorityOf(const int* classCounts, uint32_t numClasses) { //most common class, the smallest code wins a tie
+    uint32_t best = UNKNOWN_CODE;
+    int bestCount = 0;
+    for(uint32_t c = 0; c < numClasses; c++) {
+        if(classCounts[c] > bestCount) {
+            bestCount = classCounts[c];
+            best = c;
+        }
+    }
+    return best;
+}
+
+//Gini Index
+double giniSplit(const CountTable& table) { //function how pure the data is after splitting by a feature
+    double weightedGini = 0.0; //variable to store the final impurity value
+    for(uint32_t v = 0; v < table.numValues; v++) { //loop through each group
+        int size = table.valueTotals[v];
+        if(size == 0)
+            continue;
+        double weight = (double)size / table.total; //calculate the weight of the group
+        weightedGini += weight * giniFromCounts(table.row(v), table.numClasses, size); //multiply it by the group's weight and then add the result to the total
+    }
+    return weightedGini; //return the final impurity score (the lower the value = better feature to split on)
+}
+
+//Information Gain 
+double informationGain(const CountTable& table) {  //function that picks the feature with the highest information gain to split the data
+    double totalEntropy = entropyFromCounts(table.classTotals.data(), table.numClasses, table.total); //how mixed the class labels are before any splitting
+    
+    double subsetEntropy = 0.0;
+    for(uint32_t v = 0; v < table.numValues; v++) { //loop through each group 
+        int size = table.valueTotals[v];
+        if(size == 0)
+            continue;
+        double weight = (double)size / table.total; // calculate the weight of this group
+        subsetEntropy += weight * entropyFromCounts(table.row(v), table.numClasses, size); //multiply it by the group's weight and add it to the running total
+    }
+    
+    return totalEntropy - subsetEntropy; //subtract the entropy befor ethe slide and the entropy after the split 
+                                         //this gives us the information gain
+}
+
+
+//function that will be used in the gainRatio metric
+double splitInfo(const CountTable& table) {
+    return entropyFromCounts(table.valueTotals.data(), table.numValues, table.total); //entropy of the feature column itself
+}
+
+double gainRatio(const CountTable& table) {
+    double infoGain = informationGain(table); //how much the feature reduces the label uncertainity
+    double splitInformation = splitInfo(table); //measure how spread out the feature values are
+
+    if (splitInformation == 0.0 || splitInformation < 1e-10) //safety check to avoid dividing by zero
+        return 0.0;                                          //if splitInformatoin is zero or extremely small -> return 0
+
+    return infoGain / splitInformation; //Gain ratio = information gain / split info
+}
+
+//split criteria as policy types: the builder is a template on the criterion, so the score is a direct call
+//the compiler can inline into every threshold sweep instead of a string compare per candidate
+//a criterion needs a name() and a score(table) where higher is better; a custom one plugs in the same way:
+//    struct MyCriterion { static const char* name() { return "mine"; } static double score(const CountTable& t) { ... } };
+//online training also needs range(numClasses), the largest possible difference of two scores, for its Hoeffding bound
+//    DecisionTree tree = buildTree<MyCriterion>(data, rows, featureIndices, labelIndex, attributeNames, options);
+struct GiniCriterion {
+    static const char* name() { return "gini"; }
+    static double score(const CountTable& table) { return -giniSplit(table); } //lower gini is better so we negate it
+    static double range(uint32_t) { return 1.0; }
+};
+
+struct InfoGainCriterion {
+    static const char* name() { return "info"; }
+    static double score(const CountTable& table) { return informationGain(table); }
+    static double range(uint32_t numClasses) { return log2((double)max(2u, numClasses)); } //entropy of numClasses equal classes
+};
+
+struct GainRatioCriterion {
+    static const char* name() { return "gain"; }
+    static double score(const CountTable& table) { return gainRatio(table); }
+    static double range(uint32_t) { return 1.0; }
+};
+
+//turns the metric name into its criterion type once, f is called with a criterion object (use decltype to get the type)
+template <typename F>
+auto withCriterion(const string& metric, F&& f) {
+    if(metric == "info")
+        return f(InfoGainCriterion());
+    if(metric == "gain")
+        return f(GainRatioCriterion());
+    if(metric != "gini") {
+        cerr << "Unknown metric " << metric << "\n";
+        exit(1);
+    }
+    return f(GiniCriterion());
+}
+
+struct TaskGroup { //a set of tasks that someone waits on together
+    atomic<int> pending;
+    TaskGroup() : pending(0) {}
+};
+
+//work stealing thread pool: every worker pushes and pops tasks at the back of its own queue,
+//and an idle worker steals from the front of the other queues
+//threads waiting for a TaskGroup keep running queued tasks so nested waits never block the pool
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads) : stopping(false), queued(0) {
+        int numWorkers = max(numThreads - 1, 0); //the thread that waits on a group helps too
+        for(int i = 0; i <= numWorkers; i++) //the extra queue takes tasks from threads outside the pool
+            queues.emplace_back(new WorkQueue());
+        for(int i = 0; i < numWorkers; i++)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto& w : workers)
+            w.join();
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    void run(TaskGroup& group, function<void()> task) { //queue a task as part of a group
+        group.pending++;
+        WorkQueue& queue = *queues[currentQueue()];
+        {
+            lock_guard<mutex> lock(queue.lock);
+            queue.tasks.push_back([&group, task] {
+                task();
+                group.pending--;
+            });
+        }
+        queued++;
+        {
+            lock_guard<mutex> lock(sleepLock); //pairs with the check in workerLoop so the wake up is not lost
+        }
+        wake.notify_one();
+    }
+
+    void wait(TaskGroup& group) { //run queued tasks until every task of the group has finished
+        int self = currentQueue();
+        while(group.pending > 0) {
+            if(!runOne(self))
+                this_thread::yield();
+        }
+    }
+
+private:
+    struct WorkQueue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<WorkQueue>> queues;
+    vector<thread> workers;
+    bool stopping;
+    atomic<int> queued;
+    mutex sleepLock;
+    condition_variable wake;
+
+    static int& workerId() { //index of the calling worker, -1 on threads that are not in the pool
+        static thread_local int id = -1;
+        return id;
+    }
+
+    int currentQueue() const {
+        int id = workerId();
+        return id < 0 ? (int)queues.size() - 1 : id;
+    }
+
+    bool runOne(int self) { //pop our own newest task or steal the oldest task of another queue
+        function<void()> task;
+        for(size_t k = 0; k < queues.size() && !task; k++) {
+            WorkQueue& queue = *queues[(self + k) % queues.size()];
+            lock_guard<mutex> lock(queue.lock);
+            if(queue.tasks.empty())
+                continue;
+            if(k == 0) {
+                task = move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        if(!task)
+            return false;
+        queued--;
+        task();
+        return true;
+    }
+
+    void workerLoop(int id) {
+        workerId() = id;
+        while(true) {
+            if(runOne(id))
+                continue;
+            unique_lock<mutex> lock(sleepLock);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if(stopping)
+                return;
+        }
+    }
+};
+
+struct TrainOptions { //settings of one training run
+    int maxDepth;          //nodes at this depth become leaves
+    int threads;           //1 builds on the calling thread only
+    size_t parallelCutoff; //nodes with fewer rows than this are built serially
+    bool histogram;        //score numeric features on their uint8_t bins (binNumericColumns must have been called)
+    int featuresPerSplit;  //random forest: score only this many randomly chosen features at every node (0 = all of them)
+    uint64_t seed;         //seeds the feature sampling, every node derives its own generator from it
+
+    TrainOptions() : maxDepth(8), threads(1), parallelCutoff(4096), histogram(false), featuresPerSplit(0), seed(0) {}
+};
+
+uint64_t mixSeed(uint64_t seed, uint64_t salt) { //splitmix64 step, gives unrelated seeds for neighbouring salts
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull * (salt + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+struct BuildContext { //everything that stays the same for every node of one tree build
+    const Dataset& data;
+    int labelIndex;
+    const vector<string>& attributeNames;
+    int maxDepth;
+    ThreadPool* pool;      //null for a single threaded build
+    size_t parallelCutoff; //nodes with fewer rows than this are built serially
+    vector<vector<uint32_t>>& sortedRows; //numeric feature -> training rows presorted by value, partitioned along with the tree (empty for categorical features)
+    vector<uint32_t>& branch;             //row -> branch it follows at the node that is being split (numeric splits only)
+    vector<uint32_t>& scratch;            //buffer for the stable partition of the presorted arrays
+    bool histogram;                       //histogram mode: every node gets a (bin or code) x class histogram per feature
+    const vector<size_t>& histOffset;     //feature -> start of its slice in a node histogram
+    size_t histSize;                      //length of one node histogram
+    NodeArena& arena;                     //every node of the tree is allocated here
+    int featuresPerSplit;                 //0 scores every feature at every node
+};
+
+uint32_t histWidth(const Dataset& data, int f) { //rows of a feature's histogram slice: one per code, or one per bin plus the missing bin
+    return data.columns[f].numeric ? data.columns[f].numBins() + 1 : data.columns[f].cardinality();
+}
+
+//counts rows[begin,end) into the (value x class) slice of every feature in features
+//each feature has its own slice, so with a pool the features are counted as separate tasks
+void fillHistogram(const BuildContext& ctx, const vector<uint32_t>& rows, size_t begin, size_t end,
+                   const vector<int>& features, int* hist, bool parallel) {
+    const uint32_t* labels = ctx.data.columns[ctx.labelIndex].codes.data();
+    uint32_t numClasses = ctx.data.columns[ctx.labelIndex].cardinality();
+    auto countFeature = [&ctx, &rows, begin, end, hist, labels, numClasses](int f) {
+        profileCount(ROWS_SCANNED, end - begin);
+        const Column& column = ctx.data.columns[f];
+        int* cells = hist + ctx.histOffset[f];
+        fill(cells, cells + (size_t)histWidth(ctx.data, f) * numClasses, 0);
+        if(column.numeric) {
+            const uint8_t* bins = column.bins.data();
+            for(size_t i = begin; i < end; i++)
+                cells[(size_t)bins[rows[i]] * numClasses + labels[rows[i]]]++;
+        } else {
+            const uint32_t* codes = column.codes.data();
+            for(size_t i = begin; i < end; i++)
+                cells[(size_t)codes[rows[i]] * numClasses + labels[rows[i]]]++;
+        }
+    };
+    if(parallel && features.size() > 1) {
+        TaskGroup group;
+        for(int f : features)
+            ctx.pool->run(group, [&countFeature, f] { countFeature(f); });
+        ctx.pool->wait(group);
+    } else {
+        for(int f : features)
+            countFeature(f);
+    }
+}
+
+//best CART style threshold split (value <= threshold goes left) of the rows of a node on numeric feature f
+//sorted[begin,end) holds the node's rows ordered by the feature value with missing values last (they always go right)
+//one sweep moves rows from the right side to the left side of a 2 x class table and scores every boundary between two distinct values
+template <typename Criterion>
+double scoreThresholdSplit(const BuildContext& ctx, CountTable& table, const vector<uint32_t>& sorted,
+                           size_t begin, size_t end, int f, float& threshold) {
+    const float* x = ctx.data.columns[f].numbers.data();
+    const uint32_t* labels = ctx.data.columns[ctx.labelIndex].codes.data();
+    uint32_t numClasses = ctx.data.columns[ctx.labelIndex].cardinality();
+
+    table.reset(2, numClasses, (int)(end - begin));
+    int* left = table.counts.data();
+    int* right = left + numClasses;
+    for(size_t i = begin; i < end; i++) //start with every row on the right
+        right[labels[sorted[i]]]++;
+    copy(right, right + numClasses, table.classTotals.begin());
+    table.valueTotals[1] = table.total;
+
+    double best = -numeric_limits<double>::infinity(); //stays -inf if every row has the same value
+    uint64_t evaluated = 0; //added to the profile once instead of on every boundary
+    for(size_t i = begin; i + 1 < end; i++) {
+        uint32_t r = sorted[i];
+        float value = x[r];
+        if(std::isnan(value)) //only missing values are left, they cannot go left
+            break;
+        uint32_t c = labels[r]; //move the row to the left side
+        left[c]++;
+        right[c]--;
+        table.valueTotals[0]++;
+        table.valueTotals[1]--;
+
+        float nextValue = x[sorted[i + 1]];
+        if(nextValue == value) //can't split between two equal values
+            continue;
+        evaluated++;
+        double score = Criterion::score(table);
+        if(score > best) {
+            best = score;
+            threshold = std::isnan(nextValue) ? value : midpoint(value, nextValue);
+        }
+    }
+    profileCount(CANDIDATES_SCORED, evaluated);
+    return best;
+}
+
+//histogram mode version of scoreThresholdSplit: the sweep walks the bins of the node histogram instead of sorted rows
+//the threshold is the upper bound of the last bin on the left, the missing bin always stays on the right
+template <typename Criterion>
+double scoreBinnedSplit(const BuildContext& ctx, CountTable& table, const int* cells, int f, float& threshold) {
+    const Column& column = ctx.data.columns[f];
+    uint32_t numBins = column.numBins();
+    uint32_t numClasses = ctx.data.columns[ctx.labelIndex].cardinality();
+
+    table.reset(2, numClasses, 0);
+    int* left = table.counts.data();
+    int* right = left + numClasses;
+    for(uint32_t b = 0; b <= numBins; b++) { //start with every bin on the right
+        for(uint32_t c = 0; c < numClasses; c++)
+            right[c] += cells[(size_t)b * numClasses + c];
+    }
+    copy(right, right + numClasses, table.classTotals.begin());
+    for(uint32_t c = 0; c < numClasses; c++)
+        table.total += right[c];
+    table.valueTotals[1] = table.total;
+
+    double best = -numeric_limits<double>::infinity();
+    uint64_t evaluated = 0;
+    for(uint32_t b = 0; b < numBins; b++) {
+        const int* bin = cells + (size_t)b * numClasses;
+        int binRows = 0;
+        for(uint32_t c = 0; c < numClasses; c++) { //move the bin to the left side
+            left[c] += bin[c];
+            right[c] -= bin[c];
+            binRows += bin[c];
+        }
+        table.valueTotals[0] += binRows;
+        table.valueTotals[1] -= binRows;
+        if(binRows == 0 || table.valueTotals[0] == 0 || table.valueTotals[1] == 0) //same split as the bin before, or one side empty
+            continue;
+        evaluated++;
+        double score = Criterion::score(table);
+        if(score > best) {
+            best = score;
+            threshold = column.binUpper[b];
+        }
+    }
+    profileCount(CANDIDATES_SCORED, evaluated);
+    return best;
+}
+
+//score of splitting rows[begin,end) on feature f, higher is better
+//for a numeric feature the best threshold is returned in threshold
+//in histogram mode the score only reads the node histogram hist and never the rows
+template <typename Criterion>
+double scoreFeature(const BuildContext& ctx, CountTable& table, const vector<uint32_t>& rows,
+                    size_t begin, size_t end, int f, float& threshold, const int* hist) {
+    if(ctx.histogram) {
+        const int* cells = hist + ctx.histOffset[f];
+        if(ctx.data.columns[f].numeric)
+            return scoreBinnedSplit<Criterion>(ctx, table, cells, f, threshold);
+        table.load(cells, histWidth(ctx.data, f), ctx.data.columns[ctx.labelIndex].cardinality());
+        profileCount(CANDIDATES_SCORED);
+        return Criterion::score(table);
+    }
+    profileCount(ROWS_SCANNED, end - begin);
+    if(ctx.data.columns[f].numeric)
+        return scoreThresholdSplit<Criterion>(ctx, table, ctx.sortedRows[f], begin, end, f, threshold);
+
+    table.fill(ctx.data, rows, begin, end, f, ctx.labelIndex); //single pass over the node's rows for this feature
+    profileCount(CANDIDATES_SCORED);
+    return Criterion::score(table);
+}
+
+int* leafCounts(const BuildContext& ctx, const vector<uint32_t>& rows, size_t begin, size_t end) { //class counts of a leaf's rows, kept for pruning
+    int* counts = ctx.arena.makeArray<int>(ctx.data.columns[ctx.labelIndex].cardinality());
+    const uint32_t* labels = ctx.data.columns[ctx.labelIndex].codes.data();
+    for(size_t i = begin; i < end; i++)
+        counts[labels[rows[i]]]++;
+    return counts;
+}
+
+//recursive function that builds the subtree for the rows in rows[begin,end)
+//the rows array is shared by the whole build, each node reorders its own range in place and hands sub-ranges to its children
+//with a thread pool, nodes with at least ctx.parallelCutoff rows score their features in parallel and build their children as tasks;
+//every node still makes the same decisions in the same order, so the tree is identical to the single threaded one
+//in histogram mode hist is this node's histogram; children get theirs by counting all but the largest child,
+//which is the parent's histogram minus its siblings'
+//nodeSeed drives the random feature subset when ctx.featuresPerSplit is set; a child's seed depends only on
+//its parent's seed and its branch, so the tree does not depend on the order the tasks run in
+template <typename Criterion>
+Node* buildSubtree(const BuildContext& ctx, vector<uint32_t>& rows, size_t begin, size_t end,
+                   const vector<int>& featureIndices, int depth, vector<int> hist, uint64_t nodeSeed) {
+    const Dataset& data = ctx.data;
+    int labelIndex = ctx.labelIndex;
+    profileNode(depth); //every call makes exactly one node
+    
+    if(begin == end) {   //Base Case 1: If there is no data
+                        //Create a leaf node and label it as unknown
+        Node* leaf = ctx.arena.make<Node>(); 
+        leaf->isLeaf = true;
+        leaf->label = UNKNOWN_CODE;
+        leaf->classCounts = leafCounts(ctx, rows, begin, end); //all zero
+        return leaf;
+    }
+    
+    //Base Case 2: All labels are the same
+    const uint32_t* labels = data.columns[labelIndex].codes.data();
+    uint32_t firstLabel = labels[rows[begin]]; //take the label from the first row and store it (almost like a reference label to compare everything else against)
+    bool allSame = true;  //assumes all labels are the same (this assumption is tested)
+    for(size_t i = begin; i < end; i++) { //loop through every row in the node
+        if(labels[rows[i]] != firstLabel) { //compare the current row's label with the first label
+            allSame = false;                //if they are different, then set the boolean variable to false
+            break;
+        }
+    }
+    if(allSame) {
+        Node* leaf = ctx.arena.make<Node>();
+        leaf->isLeaf = true;
+        leaf->label = firstLabel;
+        leaf->classCounts = ctx.arena.makeArray<int>(data.columns[labelIndex].cardinality());
+        leaf->classCounts[firstLabel] = (int)(end - begin);
+        return leaf;
+    }
+    
+    //Base Case 3: No features left or the maximum depth has been reached
+    if(featureIndices.empty() || depth >= ctx.maxDepth) { //if no  more features to split or tree is too deep then create a leaf node and label it with the most common class
+        Node* leaf = ctx.arena.make<Node>(); 
+        leaf->isLeaf = true;
+        leaf->classCounts = leafCounts(ctx, rows, begin, end);
+        leaf->label = majorityOf(leaf->classCounts, data.columns[labelIndex].cardinality());
+        return leaf;
+    }
+    
+    bool parallel = ctx.pool != nullptr && end - begin >= ctx.parallelCutoff; //wide enough to be worth splitting into tasks
+    
+    vector<int> candidates = featureIndices; //features scored at this node
+    if(ctx.featuresPerSplit > 0 && (size_t)ctx.featuresPerSplit < featureIndices.size()) {
+        mt19937_64 rng(nodeSeed); //partial Fisher-Yates shuffle of the positions, then back into featureIndices order
+        vector<int> positions(featureIndices.size());
+        for(size_t i = 0; i < positions.size(); i++)
+            positions[i] = (int)i;
+        for(size_t i = 0; i < (size_t)ctx.featuresPerSplit; i++)
+            swap(positions[i], positions[i + rng() % (positions.size() - i)]);
+        positions.resize(ctx.featuresPerSplit);
+        sort(positions.begin(), positions.end());
+        candidates.clear();
+        for(int pos : positions)
+            candidates.push_back(featureIndices[pos]);
+    }
+    
+    vector<double> scores(candidates.size()); //metric value of every candidate feature
+    vector<float> thresholds(candidates.size()); //best threshold of every numeric candidate
+    ProfilePhase scoring("score splits");
+    if(parallel && candidates.size() > 1) {
+        TaskGroup group;
+        for(size_t i = 0; i < candidates.size(); i++) {
+            ctx.pool->run(group, [&ctx, &rows, &scores, &thresholds, &candidates, &hist, begin, end, i] {
+                CountTable table; //each task counts into its own table
+                scores[i] = scoreFeature<Criterion>(ctx, table, rows, begin, end, candidates[i], thresholds[i], hist.data());
+            });
+        }
+        ctx.pool->wait(group);
+    } else {
+        CountTable table; //one contingency table reused for every candidate feature
+        for(size_t i = 0; i < candidates.size(); i++)
+            scores[i] = scoreFeature<Criterion>(ctx, table, rows, begin, end, candidates[i], thresholds[i], hist.data());
+    }
+    scoring.finish();
+    
+    double bestScore = -1e9; 
+    int bestFeature = -1; //sentinel
+    float bestThreshold = 0.0f;
+    for(size_t i = 0; i < candidates.size(); i++) { //pick the best feature in featureIndices order so ties go to the same feature every time
+        if(scores[i] > bestScore) { //check to see if score > bestScore
+                                    //if so, update the bestScore and set bestFeature to the current feature index
+            bestScore = scores[i];
+            bestFeature = candidates[i];
+            bestThreshold = thresholds[i];
+        }
+    }
+    
+    if(bestFeature == -1) { //check if no feature was chosen (this can happen if featureIndicies was empty or scores were not better than the initial bestScore)
+        Node* leaf = ctx.arena.make<Node>();    // if true, then create a leaf node and set its label to the majority label
+        leaf->isLeaf = true;
+        leaf->classCounts = leafCounts(ctx, rows, begin, end);
+        leaf->label = majorityOf(leaf->classCounts, data.columns[labelIndex].cardinality());
+        return leaf;
+    }
+    
+    Node* node = ctx.arena.make<Node>(); //create a new node and store the featureIndex and featureName
+    node->isLeaf = false;
+    node->featureIndex = bestFeature;
+    node->featureName = ctx.arena.copyString(ctx.attributeNames[bestFeature]);
+    node->numeric = data.columns[bestFeature].numeric;
+    node->threshold = bestThreshold;
+    
+    const uint32_t* branchOf; //branch every row follows: its code for a categorical split, 0 (<= threshold) or 1 for a numeric one
+    uint32_t numBranches;
+    if(node->numeric) {
+        const float* x = data.columns[bestFeature].numbers.data();
+        for(size_t i = begin; i < end; i++)
+            ctx.branch[rows[i]] = x[rows[i]] <= bestThreshold ? 0 : 1;
+        branchOf = ctx.branch.data();
+        numBranches = 2;
+    } else {
+        branchOf = data.columns[bestFeature].codes.data();
+        numBranches = data.columns[bestFeature].cardinality();
+    }
+    
+    ProfilePhase partitioning("partition");
+    vector<size_t> offsets = partitionRows(rows, begin, end, branchOf, numBranches); //group this node's rows by branch
+    for(auto& sorted : ctx.sortedRows) { //the presorted arrays get the same groups and stay sorted inside each one
+        if(!sorted.empty())
+            stablePartitionRows(sorted, begin, end, branchOf, offsets, ctx.scratch);
+    }
+    partitioning.finish();
+    
+    vector<int> remainingFeatures; //new list to ensure that the same categorical feature is not reused down the branch
+    for(int f : featureIndices) {                     //numeric features stay since a different threshold can still help
+        if(f != bestFeature || node->numeric) {
+            remainingFeatures.push_back(f);
+        }
+    }
+    
+    size_t numChildren = offsets.size() - 1;
+    vector<vector<int>> childHists(numChildren); //histogram mode: the histogram each child starts from
+    if(ctx.histogram && depth + 1 < ctx.maxDepth) { //children at maxDepth become leaves and never look at a histogram
+        ProfilePhase phase("histograms");
+        size_t largest = 0;
+        for(size_t code = 1; code < numChildren; code++) {
+            if(offsets[code + 1] - offsets[code] > offsets[largest + 1] - offsets[largest])
+                largest = code;
+        }
+        for(size_t code = 0; code < numChildren; code++) { //count the smaller children directly
+            if(code == largest || offsets[code] == offsets[code + 1])
+                continue;
+            childHists[code].resize(ctx.histSize);
+            profileCount(BYTES_ALLOCATED, ctx.histSize * sizeof(int));
+            fillHistogram(ctx, rows, offsets[code], offsets[code + 1], remainingFeatures, childHists[code].data(), parallel);
+        }
+        childHists[largest] = move(hist); //largest child = parent - siblings
+        for(size_t code = 0; code < numChildren; code++) {
+            if(childHists[code].empty() || code == largest)
+                continue;
+            for(int f : remainingFeatures) {
+                size_t first = ctx.histOffset[f];
+                size_t last = first + (size_t)histWidth(data, f) * data.columns[labelIndex].cardinality();
+                for(size_t k = first; k < last; k++)
+                    childHists[largest][k] -= childHists[code][k];
+            }
+        }
+    }
+    
+    vector<Node*> childNodes(numChildren, nullptr); //tasks write into their own slot, the map is filled afterwards
+    if(parallel) {
+        TaskGroup group;
+        for(size_t code = 0; code < numChildren; code++) { //every non empty group becomes a task that builds one child
+            if(offsets[code] == offsets[code + 1])
+                continue;
+            ctx.pool->run(group, [&ctx, &rows, &offsets, &remainingFeatures, &childNodes, &childHists, code, depth, nodeSeed] {
+                childNodes[code] = buildSubtree<Criterion>(ctx, rows, offsets[code], offsets[code + 1], remainingFeatures, depth + 1,
+                                                move(childHists[code]), mixSeed(nodeSeed, code));
+            });
+        }
+        ctx.pool->wait(group);
+    } else {
+        for(size_t code = 0; code < numChildren; code++) { //loop throuh the groups and recursively build a child on each range
+            if(offsets[code] == offsets[code + 1])
+                continue;
+            childNodes[code] = buildSubtree<Criterion>(ctx, rows, offsets[code], offsets[code + 1], remainingFeatures, depth + 1,
+                                            move(childHists[code]), mixSeed(nodeSeed, code));
+        }
+    }
+    
+    uint32_t numChildNodes = (uint32_t)childNodes.size(); //trailing codes without a child are left out of the table
+    while(numChildNodes > 0 && childNodes[numChildNodes - 1] == nullptr)
+        numChildNodes--;
+    node->children = ctx.arena.makeArray<Node*>(numChildNodes);
+    node->numChildren = numChildNodes;
+    copy(childNodes.begin(), childNodes.begin() + numChildNodes, node->children);
+    uint32_t numClasses = data.columns[labelIndex].cardinality();
+    node->classCounts = ctx.arena.makeArray<int>(numClasses); //every row went to a child, so the counts are their sum
+    for(uint32_t code = 0; code < numChildNodes; code++) {
+        if(node->children[code] == nullptr)
+            continue;
+        for(uint32_t c = 0; c < numClasses; c++)
+            node->classCounts[c] += node->children[code]->classCounts[c];
+    }
+    
+    return node;
+}
+
+//builds the decision tree on the given training rows, scoring splits with Criterion
+//rows is taken by value since the build reorders it
+template <typename Criterion>
+DecisionTree buildTree(const Dataset& data, vector<uint32_t> rows, const vector<int>& featureIndices,
+                       int labelIndex, const vector<string>& attributeNames, const TrainOptions& options = TrainOptions()) {
+    ProfilePhase phase("buildTree");
+    vector<size_t> histOffset(data.columns.size(), 0);
+    size_t histSize = 0;
+    if(options.histogram) { //lay out one slice per feature in every node histogram
+        for(int f : featureIndices) {
+            if(data.columns[f].numeric && data.columns[f].bins.size() != data.size()) {
+                cerr << "Histogram mode needs binNumericColumns to be called after loading\n";
+                exit(1);
+            }
+            histOffset[f] = histSize;
+            histSize += (size_t)histWidth(data, f) * data.columns[labelIndex].cardinality();
+        }
+    }
+
+    ProfilePhase presorting("presort");
+    vector<vector<uint32_t>> sortedRows(data.columns.size());
+    for(int f : featureIndices) { //sort the training rows once per numeric feature, missing values go last
+        if(!data.columns[f].numeric || options.histogram) //histogram mode searches thresholds on the bins instead
+            continue;
+        profileCount(BYTES_ALLOCATED, rows.size() * sizeof(uint32_t));
+        const float* x = data.columns[f].numbers.data();
+        sortedRows[f] = rows;
+        sort(sortedRows[f].begin(), sortedRows[f].end(), [x](uint32_t a, uint32_t b) {
+            if(std::isnan(x[b]))
+                return !std::isnan(x[a]) || a < b;
+            if(std::isnan(x[a]))
+                return false;
+            return x[a] < x[b] || (x[a] == x[b] && a < b);
+        });
+    }
+    presorting.finish();
+    vector<uint32_t> branch(data.size());
+    vector<uint32_t> scratch(rows.size());
+
+    unique_ptr<ThreadPool> pool;
+    if(options.threads > 1)
+        pool.reset(new ThreadPool(options.threads));
+    DecisionTree tree;
+    BuildContext ctx = {data, labelIndex, attributeNames, options.maxDepth, pool.get(), options.parallelCutoff,
+                        sortedRows, branch, scratch, options.histogram, histOffset, histSize, *tree.arena,
+                        options.featuresPerSplit};
+
+    vector<int> rootHist;
+    if(options.histogram) {
+        rootHist.resize(histSize);
+        profileCount(BYTES_ALLOCATED, histSize * sizeof(int));
+        fillHistogram(ctx, rows, 0, rows.size(), featureIndices, rootHist.data(), pool != nullptr);
+    }
+    tree.root = buildSubtree<Criterion>(ctx, rows, 0, rows.size(), featureIndices, 0, move(rootHist), options.seed);
+    return tree;
+}
+
+DecisionTree buildTree(const Dataset& data, const vector<uint32_t>& rows, const vector<int>& featureIndices, 
+                int labelIndex, const string& metric, const vector<string>& attributeNames,
+                const TrainOptions& options = TrainOptions()) { //picks the criterion from the metric name once, then builds with it
+    return withCriterion(metric, [&](auto criterion) {
+        return buildTree<decltype(criterion)>(data, rows, featureIndices, labelIndex, attributeNames, options);
+    });
+}
+
+const uint32_t NO_CHILD = UINT32_MAX; //childTable entry of a branch that was never seen in training
+
+struct FlatNode { //one node of a FlatTree
+    int32_t feature;     //column the node splits on, -1 for a leaf
+    uint32_t label;      //leaf: its label code; split node: fallback label when the row's branch has no child
+    uint32_t childBegin; //first entry of this node's block in childTable
+    uint32_t childCount; //branches in the block: codes 0..childCount-1 for a categorical split, 2 for a numeric one
+    float threshold;     //numeric split: value <= threshold takes branch 0, anything else branch 1 (NaN for other nodes)
+    uint32_t numeric;    //1 for a numeric split
+};
+
+//compact read only copy of a trained tree used for prediction
+//nodes are stored breadth first in one array and every split node owns a dense block of childTable,
+//indexed by the row's code (or 0/1 for a numeric split), that holds the child's node index or NO_CHILD
+//the arrays live in storage: vectors for a tree flattened in this process, or a mapped model file
+struct FlatTree {
+    const FlatNode* nodes; //nodes[0] is the root
+    size_t numNodes;
+    const uint32_t* childTable;
+    size_t childTableSize;
+    size_t numericSplits; //number of threshold split nodes
+    shared_ptr<const void> storage; //keeps the memory behind nodes and childTable alive, copies share it
+
+    FlatTree() : nodes(nullptr), numNodes(0), childTable(nullptr), childTableSize(0), numericSplits(0) {}
+
+    size_t size() const { return numNodes; }
+};
+
+struct FlatTreeArrays { //storage of a FlatTree built in memory
+    vector<FlatNode> nodes;
+    vector<uint32_t> childTable;
+};
+
+//label used when a row reaches a node without a child for its value:
+//the most common label among the node's leaf children (the smallest code wins a tie), or unknown if it has none
+uint32_t fallbackLabel(const Node* node) {
+    map<uint32_t, int> labelCounts;
+    for(uint32_t code = 0; code < node->numChildren; code++) {
+        const Node* child = node->children[code];
+        if(child != nullptr && child->isLeaf)
+            labelCounts[child->label]++;
+    }
+    uint32_t bestLabel = UNKNOWN_CODE;
+    int maxCount = 0;
+    for(auto& pair : labelCounts) {
+        if(pair.second > maxCount) {
+            maxCount = pair.second;
+            bestLabel = pair.first;
+        }
+    }
+    return bestLabel;
+}
+
+FlatTree flattenTree(const Node* root) { //compile step that turns a trained tree into a FlatTree
+    auto arrays = make_shared<FlatTreeArrays>();
+    FlatTreeArrays& flat = *arrays;
+    size_t numericSplits = 0;
+    vector<const Node*> order(1, root); //breadth first queue, a node's position in it is its index in flat.nodes
+    for(size_t i = 0; i < order.size(); i++) {
+        const Node* node = order[i];
+        FlatNode fn;
+        fn.feature = node->isLeaf ? -1 : node->featureIndex;
+        fn.label = node->isLeaf || node->label != UNKNOWN_CODE ? node->label : fallbackLabel(node);
+        fn.threshold = node->numeric ? node->threshold : numeric_limits<float>::quiet_NaN();
+        fn.numeric = node->numeric ? 1 : 0;
+        numericSplits += fn.numeric;
+        fn.childBegin = (uint32_t)flat.childTable.size();
+        fn.childCount = 0;
+        if(!node->isLeaf) {
+            fn.childCount = node->numeric ? 2 : node->numChildren;
+            flat.childTable.resize(flat.childTable.size() + fn.childCount, NO_CHILD);
+            for(uint32_t code = 0; code < node->numChildren; code++) { //children get the next free positions in the queue
+                if(node->children[code] == nullptr)
+                    continue;
+                flat.childTable[fn.childBegin + code] = (uint32_t)order.size();
+                order.push_back(node->children[code]);
+            }
+        }
+        flat.nodes.push_back(fn);
+    }
+
+    FlatTree tree;
+    tree.nodes = flat.nodes.data();
+    tree.numNodes = flat.nodes.size();
+    tree.childTable = flat.childTable.data();
+    tree.childTableSize = flat.childTable.size();
+    tree.numericSplits = numericSplits;
+    tree.storage = arrays;
+    return tree;
+}
+
+//classifies one encoded row of the dataset and returns the label code
+//walks the flat tree in a loop, so there is no recursion and nothing is allocated
+uint32_t predict(const FlatTree& tree, const Dataset& data, uint32_t row) {
+    const FlatNode* nodes = tree.nodes;
+    const uint32_t* childTable = tree.childTable;
+    uint32_t i = 0;
+    while(true) {
+        const FlatNode& node = nodes[i];
+        if(node.feature < 0) //leaf: no more decisions to make
+            return node.label;
+
+        uint32_t branch; //branch of the row at the feature this node splits on
+        if(node.numeric)
+            branch = data.number(row, node.feature) <= node.threshold ? 0 : 1;
+        else
+            branch = data.code(row, node.feature);
+
+        if(branch >= node.childCount || childTable[node.childBegin + branch] == NO_CHILD)
+            return node.label; //value never seen here during training, use the precomputed fallback
+        i = childTable[node.childBegin + branch];
+    }
+}
+
+union Cell { //one cell of an encoded row: the code of a categorical value or the number of a numeric one
+    uint32_t code;
+    float number;
+};
+
+//writes the given dataset rows into a row major block, one Cell per column (stride = number of columns)
+void encodeRows(const Dataset& data, const uint32_t* rows, size_t count, Cell* out) {
+    size_t stride = data.columns.size();
+    for(size_t c = 0; c < stride; c++) { //column by column so each column is read sequentially
+        const Column& column = data.columns[c];
+        Cell* cell = out + c;
+        if(column.numeric) {
+            for(size_t i = 0; i < count; i++, cell += stride)
+                cell->number = column.numbers[rows[i]];
+        } else {
+            for(size_t i = 0; i < count; i++, cell += stride)
+                cell->code = column.codes[rows[i]];
+        }
+    }
+}
+
+const size_t BATCH_LANES = 16; //rows walked through the tree together by the scalar batch kernel
+
+//scalar batch kernel: walks BATCH_LANES rows down the tree one level at a time,
+//so the node loads of different rows overlap instead of waiting on each other
+void predictBatchScalar(const FlatTree& tree, const Cell* cells, size_t numRows, size_t stride, uint32_t* out) {
+    const FlatNode* nodes = tree.nodes;
+    const uint32_t* childTable = tree.childTable;
+    uint32_t at[BATCH_LANES]; //node each lane is on
+    for(size_t start = 0; start < numRows; start += BATCH_LANES) {
+        size_t lanes = min(BATCH_LANES, numRows - start);
+        const Cell* block = cells + start * stride;
+        uint32_t pending = (1u << lanes) - 1; //bit per lane still walking
+        for(size_t l = 0; l < lanes; l++)
+            at[l] = 0;
+        while(pending != 0) {
+            for(size_t l = 0; l < lanes; l++) {
+                if(!(pending & (1u << l)))
+                    continue;
+                const FlatNode& node = nodes[at[l]];
+                uint32_t next = NO_CHILD;
+                if(node.feature >= 0) {
+                    const Cell& cell = block[l * stride + node.feature];
+                    uint32_t branch = node.numeric ? (cell.number <= node.threshold ? 0 : 1) : cell.code;
+                    if(branch < node.childCount)
+                        next = childTable[node.childBegin + branch];
+                }
+                if(next == NO_CHILD) { //leaf, or a value with no branch: this row is done
+                    out[start + l] = node.label;
+                    pending &= ~(1u << l);
+                } else {
+                    at[l] = next;
+                }
+            }
+        }
+    }
+}
+
+#ifdef HAVE_AVX2_KERNELS
+static_assert(sizeof(FlatNode) == 6 * sizeof(int32_t), "the AVX2 kernel gathers FlatNode fields as 32 bit words");
+
+//one level of the AVX2 batch kernel for 8 rows: at holds each row's node, pending the rows still walking
+//node fields, cells and child entries are fetched with gathers and the 8 threshold compares are one vector compare;
+//categorical nodes store a NaN threshold, which is how the kernel tells them apart from numeric ones
+__attribute__((target("avx2")))
+static inline void predictStepAvx2(const int* nodeWords, const int* childTable, const int* block, __m256i rowBase,
+                                   __m256i& at, __m256i& pending) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i allOnes = _mm256_set1_epi32(-1); //also NO_CHILD
+    const __m256i signBit = _mm256_set1_epi32((int)0x80000000u);
+    __m256i word = _mm256_mullo_epi32(at, _mm256_set1_epi32(6));
+
+    __m256i feature = _mm256_mask_i32gather_epi32(allOnes, nodeWords, word, pending, 4);
+    pending = _mm256_andnot_si256(_mm256_cmpgt_epi32(zero, feature), pending); //rows on a leaf are done
+    __m256i childBegin = _mm256_mask_i32gather_epi32(zero, nodeWords + 2, word, pending, 4);
+    __m256i childCount = _mm256_mask_i32gather_epi32(zero, nodeWords + 3, word, pending, 4);
+    __m256 threshold = _mm256_castsi256_ps(_mm256_mask_i32gather_epi32(zero, nodeWords + 4, word, pending, 4));
+
+    __m256i cell = _mm256_mask_i32gather_epi32(zero, block, _mm256_add_epi32(rowBase, feature), pending, 4);
+    __m256i goesRight = _mm256_andnot_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(cell), threshold, _CMP_LE_OQ)), one);
+    __m256i numeric = _mm256_castps_si256(_mm256_cmp_ps(threshold, threshold, _CMP_ORD_Q));
+    __m256i branch = _mm256_blendv_epi8(cell, goesRight, numeric);
+
+    __m256i inRange = _mm256_cmpgt_epi32(_mm256_xor_si256(childCount, signBit), _mm256_xor_si256(branch, signBit)); //unsigned branch < childCount
+    __m256i child = _mm256_mask_i32gather_epi32(allOnes, childTable, _mm256_add_epi32(childBegin, branch),
+                                                _mm256_and_si256(pending, inRange), 4);
+    pending = _mm256_andnot_si256(_mm256_cmpeq_epi32(child, allOnes), pending); //no branch for this value: stop on this node
+    at = _mm256_blendv_epi8(at, child, pending);
+}
+
+//AVX2 batch kernel: two vectors of 8 rows walk the tree together so their gathers overlap
+//every row stops on the node whose label it gets (a leaf, or the node holding the fallback label),
+//so the labels are gathered once at the end
+__attribute__((target("avx2")))
+void predictBatchAvx2(const FlatTree& tree, const Cell* cells, size_t numRows, size_t stride, uint32_t* out) {
+    const int* nodeWords = (const int*)tree.nodes;
+    const int* childTable = (const int*)tree.childTable;
+    const __m256i rowBase = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+
+    size_t start = 0;
+    for(; start + 16 <= numRows; start += 16) {
+        const int* blockA = (const int*)(cells + start * stride);
+        const int* blockB = (const int*)(cells + (start + 8) * stride);
+        __m256i atA = _mm256_setzero_si256(), atB = _mm256_setzero_si256();
+        __m256i pendingA = _mm256_set1_epi32(-1), pendingB = _mm256_set1_epi32(-1);
+        while(!_mm256_testz_si256(_mm256_or_si256(pendingA, pendingB), _mm256_or_si256(pendingA, pendingB))) {
+            predictStepAvx2(nodeWords, childTable, blockA, rowBase, atA, pendingA);
+            predictStepAvx2(nodeWords, childTable, blockB, rowBase, atB, pendingB);
+        }
+        __m256i wordA = _mm256_mullo_epi32(atA, _mm256_set1_epi32(6));
+        __m256i wordB = _mm256_mullo_epi32(atB, _mm256_set1_epi32(6));
+        _mm256_storeu_si256((__m256i*)(out + start), _mm256_i32gather_epi32(nodeWords + 1, wordA, 4));
+        _mm256_storeu_si256((__m256i*)(out + start + 8), _mm256_i32gather_epi32(nodeWords + 1, wordB, 4));
+    }
+    _mm256_zeroupper(); //gcc leaves the upper halves dirty here, which slows down every SSE instruction (libm too) that runs after us
+    predictBatchScalar(tree, cells + start * stride, numRows - start, stride, out + start); //leftover rows
+}
+#endif
+
+//batch prediction: classifies numRows encoded rows (stride Cells apart) and writes their label codes to out
+//this is for rows that are not in a Dataset (streamed chunks, served requests), dataset rows go through predictColumns
+//the AVX2 kernel is only used for trees with threshold splits, on purely categorical trees the
+//gathers cost more than the interleaved scalar walk
+void predictBatch(const FlatTree& tree, const Cell* cells, size_t numRows, size_t stride, uint32_t* out) {
+#ifdef HAVE_AVX2_KERNELS
+    if(tree.numericSplits > 0 && cpuHasAvx2) {
+        predictBatchAvx2(tree, cells, numRows, stride, out);
+        return;
+    }
+#endif
+    predictBatchScalar(tree, cells, numRows, stride, out);
+}
+
+const size_t COLUMN_LANES = 16; //rows walked together by predictColumns
+
+//batch kernel that works straight on the columnar dataset: nothing is copied, a node reads its split column at the row
+//columns[f] holds the codes of column f, or the bits of its floats for a numeric column
+//COLUMN_LANES rows take one step each in turn, so their dependent loads overlap; a lane whose row is done
+//takes the next row right away, so no lane idles while the deepest row of a group finishes
+template<bool MixedSplits>
+void predictColumnsKernel(const FlatTree& tree, const uint32_t* const* columns, const uint32_t* rows, size_t count, uint32_t* out) {
+    const FlatNode* nodes = tree.nodes;
+    const uint32_t* childTable = tree.childTable;
+    size_t lanes = min(COLUMN_LANES, count);
+    uint32_t at[COLUMN_LANES];   //node each lane is on
+    size_t slot[COLUMN_LANES];   //position in rows of the row each lane walks
+    for(size_t l = 0; l < lanes; l++) {
+        slot[l] = l;
+        at[l] = 0;
+    }
+    size_t waiting = lanes; //next row to hand to a lane
+    while(lanes > 0) {
+        for(size_t l = 0; l < lanes; ) {
+            const FlatNode& node = nodes[at[l]];
+            uint32_t child = NO_CHILD;
+            if(node.feature >= 0) {
+                uint32_t bits = columns[node.feature][rows[slot[l]]];
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                uint32_t branch;
+                if(MixedSplits) { //a mask rather than ?:, as a branch it mispredicts when split types alternate
+                    uint32_t numeric = 0u - node.numeric;
+                    branch = (bits & ~numeric) | ((uint32_t)!(value <= node.threshold) & numeric);
+                } else {
+                    branch = node.numeric ? (value <= node.threshold ? 0 : 1) : bits;
+                }
+                if(branch < node.childCount)
+                    child = childTable[node.childBegin + branch];
+            }
+            if(child != NO_CHILD) {
+                at[l] = child;
+                l++;
+                continue;
+            }
+            out[slot[l]] = node.label; //leaf, or a value with no branch: the row is done
+            if(waiting < count) {
+                slot[l] = waiting++;
+                at[l] = 0;
+                l++;
+            } else { //nothing left to hand out, the last lane moves here
+                lanes--;
+                slot[l] = slot[lanes];
+                at[l] = at[lanes];
+            }
+        }
+    }
+}
+
+//writes the label code of rows[i] to out[i]
+//there is no AVX2 version: one that gathered each lane's column pointer and then its cell, with groups of 16 rows
+//like predictBatchAvx2, ran 1.2-1.5x slower than this kernel on the numeric bench datasets (adult, letter, pen, students)
+//the two dependent gathers per cell cost more than the scalar loads, and fixed groups wait for their deepest row
+void predictColumns(const FlatTree& tree, const uint32_t* const* columns, const uint32_t* rows, size_t count, uint32_t* out) {
+    bool mixed = tree.numericSplits > 0 && tree.childTableSize != 2 * tree.numericSplits; //a numeric split owns 2 entries
+    if(mixed)
+        predictColumnsKernel<true>(tree, columns, rows, count, out);
+    else
+        predictColumnsKernel<false>(tree, columns, rows, count, out);
+}
+
+void columnWords(const Dataset& data, vector<const uint32_t*>& columns) { //fills the columns argument of predictColumns
+    columns.clear();
+    for(const Column& column : data.columns) {
+        static_assert(sizeof(float) == sizeof(uint32_t), "numeric columns are read as 32 bit words");
+        columns.push_back(column.numeric ? (const uint32_t*)column.numbers.data() : column.codes.data());
+    }
+}
+
+const size_t SMALL_BATCH = 4 * COLUMN_LANES; //fewer rows than this are walked one at a time, the lanes would barely fill
+
+//writes the label code of dataset row rows[i] to out[i] without allocating
+void predictRows(const FlatTree& tree, const Dataset& data, const uint32_t* rows, size_t count, uint32_t* out) {
+    if(count < SMALL_BATCH) {
+        for(size_t i = 0; i < count; i++)
+            out[i] = predict(tree, data, rows[i]);
+        return;
+    }
+    thread_local vector<const uint32_t*> columns; //reused, the table is only rebuilt, never reallocated
+    columnWords(data, columns);
+    predictColumns(tree, columns.data(), rows, count, out);
+}
+
+//predicts the label code of every given dataset row
+vector<uint32_t> predictRows(const FlatTree& tree, const Dataset& data, const vector<uint32_t>& rows) {
+    vector<uint32_t> predictions(rows.size());
+    predictRows(tree, data, rows.data(), rows.size(), predictions.data());
+    return predictions;
+}
+
+//Evaluation
+//output file written through one large buffer, numbers are formatted with to_chars instead of going through a stream
+class BufferedWriter {
+public:
+    explicit BufferedWriter(const string& filename, size_t capacity = 1 << 20)
+        : file(fopen(filename.c_str(), "wb")), capacity(capacity), failed(file == nullptr) {
+        buffer.reserve(capacity);
+    }
+
+    ~BufferedWriter() { close(); }
+
+    bool ok() const { return !failed; }
+
+    void write(string_view text) {
+        if(buffer.size() + text.size() > capacity)
+            flush();
+        buffer.append(text.data(), text.size());
+    }
+
+    void put(char c) {
+        if(buffer.size() == capacity)
+            flush();
+        buffer.push_back(c);
+    }
+
+    void writeNumber(uint64_t number) {
+        char digits[20];
+        char* end = to_chars(digits, digits + sizeof(digits), number).ptr;
+        write(string_view(digits, end - digits));
+    }
+
+    bool close() { //false if any write failed
+        if(file != nullptr) {
+            flush();
+            failed |= fclose(file) != 0;
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+private:
+    FILE* file;
+    string buffer;
+    size_t capacity;
+    bool failed;
+
+    void flush() {
+        if(file != nullptr && !buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+            failed = true;
+        buffer.clear();
+    }
+};
+
+void writePredictionLine(BufferedWriter& out, uint64_t sampleId, string_view actual, string_view predicted) {
+    out.writeNumber(sampleId);
+    out.put(',');
+    out.write(actual);
+    out.put(',');
+    out.write(predicted);
+    out.put('\n');
+}
+
+//writes "SampleID,Actual,Predicted" for every row of data, predictions[i] being the label code predicted for row i
+//actual is the label column as it was read (its own codes and strings), predictions are decoded with data's label dictionary
+bool writePredictions(const string& filename, const vector<uint32_t>& predictions, const Column& actual, const Dataset& data,
+                      int labelIndex) {
+    BufferedWriter out(filename);
+    if(!out.ok())
+        return false;
+    out.write("SampleID,Actual,Predicted\n");
+    const uint32_t* labels = actual.codes.data();
+    for(size_t i = 0; i < data.size(); i++)
+        writePredictionLine(out, i + 1, actual.values[labels[i]], data.decode(labelIndex, predictions[i]));
+    return out.close();
+}
+
+struct Evaluation { //how one set of predictions did on the rows whose label is known
+    uint32_t numClasses;
+    size_t rows;
+    size_t correct;
+    vector<size_t> confusion; //actual * (numClasses + 1) + predicted, predicted numClasses counts rows left without a label
+
+    size_t count(uint32_t actual, uint32_t predicted) const { return confusion[actual * (numClasses + 1) + predicted]; }
+
+    double accuracy() const { return rows == 0 ? 0.0 : (double)correct / rows * 100.0; }
+};
+
+//one pass over rows fills the confusion matrix, predictions[row] is the label code predicted for that row
+Evaluation evaluate(const vector<uint32_t>& predictions, const Dataset& data, const vector<uint32_t>& rows, int labelIndex) {
+    Evaluation result;
+    result.numClasses = data.columns[labelIndex].cardinality();
+    result.rows = 0;
+    result.correct = 0;
+    result.confusion.assign((size_t)result.numClasses * (result.numClasses + 1), 0);
+    const uint32_t* labels = data.columns[labelIndex].codes.data();
+    for(uint32_t row : rows) {
+        uint32_t actual = labels[row];
+        if(actual >= result.numClasses) //label the model has never seen, nothing to compare with
+            continue;
+        uint32_t predicted = min(predictions[row], result.numClasses);
+        result.rows++;
+        result.correct += predicted == actual;
+        result.confusion[actual * (result.numClasses + 1) + predicted]++;
+    }
+    return result;
+}
+
+double calculateAccuracy(const FlatTree& tree, const Dataset& data, const vector<uint32_t>& rows, int labelIndex) { //function to measure how accruate the decision tree is
+    vector<uint32_t> batch = predictRows(tree, data, rows); //predict the whole set in batches
+    vector<uint32_t> predictions(data.size(), UNKNOWN_CODE); //indexed by row, the layout evaluate reads
+    for(size_t i = 0; i < rows.size(); i++)
+        predictions[rows[i]] = batch[i];
+    return evaluate(predictions, data, rows, labelIndex).accuracy();
+}
+
+//confusion matrix (rows are the actual labels) followed by precision and recall of every class
+void printEvaluation(const Evaluation& eval, const Dataset& data, int labelIndex) {
+    uint32_t n = eval.numClasses;
+    bool anyUnlabelled = false;
+    size_t width = 7; //wide enough for the header and the largest count
+    for(uint32_t a = 0; a < n; a++) {
+        width = max(width, data.decode(labelIndex, a).size() + 2);
+        anyUnlabelled |= eval.count(a, n) > 0;
+    }
+    width = max(width, to_string(eval.rows).size() + 2);
+    uint32_t columns = anyUnlabelled ? n + 1 : n; //the "unknown" column only shows up if it is used
+    if(anyUnlabelled)
+        width = max(width, data.decode(labelIndex, n).size() + 2);
+
+    cout << "Confusion Matrix:\n" << setw(width) << "";
+    for(uint32_t p = 0; p < columns; p++)
+        cout << setw(width) << data.decode(labelIndex, p); //code n decodes to "unknown"
+    cout << "\n";
+    for(uint32_t a = 0; a < n; a++) {
+        cout << left << setw(width) << data.decode(labelIndex, a) << right;
+        for(uint32_t p = 0; p < columns; p++)
+            cout << setw(width) << eval.count(a, p);
+        cout << "\n";
+    }
+
+    cout << "\n" << left << setw(width) << "Class" << right << setw(11) << "Precision" << setw(9) << "Recall" << setw(8) << "Support" << "\n";
+    for(uint32_t c = 0; c < n; c++) {
+        size_t predicted = 0, actual = 0;
+        for(uint32_t o = 0; o < n; o++) {
+            predicted += eval.count(o, c);
+            actual += eval.count(c, o);
+        }
+        actual += eval.count(c, n);
+        cout << left << setw(width) << data.decode(labelIndex, c) << right << fixed << setprecision(2);
+        if(predicted > 0) //never predicted: precision is undefined
+            cout << setw(10) << 100.0 * eval.count(c, c) / predicted << "%";
+        else
+            cout << setw(11) << "-";
+        if(actual > 0)
+            cout << setw(8) << 100.0 * eval.count(c, c) / actual << "%";
+        else
+            cout << setw(9) << "-";
+        cout << setw(8) << actual << "\n";
+    }
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+}
+
+//Pruning
+//both pruners work on the class counts buildTree left on every node, so the training rows are never read again;
+//a pruned node becomes a leaf labelled with its majority class and its subtree simply stays unused in the arena
+size_t countNodes(const Node* node) {
+    size_t count = 1;
+    for(uint32_t code = 0; code < node->numChildren; code++)
+        if(node->children[code] != nullptr)
+            count += countNodes(node->children[code]);
+    return count;
+}
+
+void makeLeaf(Node* node, uint32_t numClasses) { //collapse a split node into a leaf
+    node->isLeaf = true;
+    node->label = majorityOf(node->classCounts, numClasses);
+    node->numChildren = 0;
+    node->numeric = false; //a leaf has no threshold, flattenTree and the model file count numeric nodes as splits
+    node->threshold = 0.0f;
+}
+
+//fixes every split node's fallback label (what a row gets when its value has no branch) to the one the full tree would use,
+//so collapsing a child can't change the answer for those rows behind the pruner's back
+void freezeFallbacks(Node* node, uint32_t numClasses) {
+    if(node->isLeaf)
+        return;
+    for(uint32_t code = 0; code < node->numChildren; code++)
+        if(node->children[code] != nullptr)
+            freezeFallbacks(node->children[code], numClasses);
+    if(node->label == UNKNOWN_CODE) {
+        node->label = fallbackLabel(node);
+        if(node->label == UNKNOWN_CODE) //no leaf children, the node's own majority is the next best guess
+            node->label = majorityOf(node->classCounts, numClasses);
+    }
+}
+
+uint32_t branchOfRow(const Node* node, const Dataset& data, uint32_t row) { //same branch predict takes
+    if(node->numeric)
+        return data.number(row, node->featureIndex) <= node->threshold ? 0 : 1;
+    return data.code(row, node->featureIndex);
+}
+
+//reduced error pruning: bottom up, a node becomes a leaf if that makes no more mistakes on the validation rows
+//than its (already pruned) subtree; rows[begin,end) are the validation rows reaching node, reordered in place like the build
+//returns the validation errors of what is left of the subtree
+size_t reducedErrorPrune(Node* node, const Dataset& data, int labelIndex, vector<uint32_t>& rows, size_t begin, size_t end,
+                         vector<uint32_t>& branch) {
+    const uint32_t* labels = data.columns[labelIndex].codes.data();
+    size_t leafErrors = 0; //errors if this node answered with its majority class
+    uint32_t numClasses = data.columns[labelIndex].cardinality();
+    uint32_t majority = majorityOf(node->classCounts, numClasses);
+    for(size_t i = begin; i < end; i++)
+        leafErrors += labels[rows[i]] != (node->isLeaf ? node->label : majority);
+    if(node->isLeaf)
+        return leafErrors;
+
+    for(size_t i = begin; i < end; i++) { //group the rows by branch, values without a child go in one extra group at the end
+        uint32_t b = branchOfRow(node, data, rows[i]);
+        branch[rows[i]] = node->child(b) != nullptr ? b : node->numChildren;
+    }
+    vector<size_t> offsets = partitionRows(rows, begin, end, branch.data(), node->numChildren + 1);
+    size_t subtreeErrors = 0;
+    for(uint32_t code = 0; code < node->numChildren; code++)
+        if(node->children[code] != nullptr)
+            subtreeErrors += reducedErrorPrune(node->children[code], data, labelIndex, rows, offsets[code], offsets[code + 1], branch);
+    for(size_t i = offsets[node->numChildren]; i < end; i++) //these stop here and get the fallback label
+        subtreeErrors += labels[rows[i]] != node->label;
+
+    if(leafErrors <= subtreeErrors) { //ties prune too, the smaller tree is as good
+        makeLeaf(node, numClasses);
+        return leafErrors;
+    }
+    return subtreeErrors;
+}
+
+void reducedErrorPrune(DecisionTree& tree, const Dataset& data, int labelIndex, vector<uint32_t> validationRows) {
+    uint32_t numClasses = data.columns[labelIndex].cardinality();
+    freezeFallbacks(tree.root, numClasses);
+    vector<uint32_t> branch(data.size());
+    reducedErrorPrune(tree.root, data, labelIndex, validationRows, 0, validationRows.size(), branch);
+}
+
+struct PruneStep { //one tree of the cost complexity sequence
+    double alpha;    //cost per leaf (as a share of the training rows) from which on this tree is the best
+    size_t leaves;
+    size_t nodes;
+    double accuracy; //on the validation rows
+};
+
+//minimal cost complexity pruning (CART): R(t) is the share of training rows a node gets wrong as a leaf, and the weakest link,
+//the split node with the smallest (R(t) - R(subtree)) / (leaves - 1), is collapsed again and again until only the root is left
+//every collapse gives the alpha at which the smaller tree becomes the better one; each validation row is then followed
+//down the tree once to find, for every alpha, where it stops and whether that answer is right
+//the tree is pruned to the step with the best validation accuracy (ties go to the larger alpha) and the whole sweep is returned
+vector<PruneStep> costComplexityPrune(DecisionTree& tree, const Dataset& data, int labelIndex, const vector<uint32_t>& validationRows) {
+    uint32_t numClasses = data.columns[labelIndex].cardinality();
+    freezeFallbacks(tree.root, numClasses);
+
+    struct Entry {
+        Node* node;
+        int parent;
+        double leafCost; //R(t)
+        double alpha;    //alpha at which the node is collapsed itself, inf if it never is (or is a leaf)
+    };
+    vector<Entry> entries; //post order, so children come before their parent
+    unordered_map<const Node*, int> indexOf;
+    double totalRows = 0;
+    for(uint32_t c = 0; c < numClasses; c++)
+        totalRows += tree.root->classCounts[c];
+    function<int(Node*)> collect = [&](Node* node) {
+        vector<int> children;
+        for(uint32_t code = 0; code < node->numChildren; code++)
+            if(node->children[code] != nullptr)
+                children.push_back(collect(node->children[code]));
+        int rowsHere = 0;
+        for(uint32_t c = 0; c < numClasses; c++)
+            rowsHere += node->classCounts[c];
+        uint32_t majority = majorityOf(node->classCounts, numClasses);
+        double leafCost = (rowsHere - (majority == UNKNOWN_CODE ? 0 : node->classCounts[majority])) / max(1.0, totalRows);
+        int self = (int)entries.size();
+        entries.push_back({node, -1, leafCost, numeric_limits<double>::infinity()});
+        for(int child : children)
+            entries[child].parent = self;
+        indexOf[node] = self;
+        return self;
+    };
+    collect(tree.root);
+
+    size_t n = entries.size();
+    vector<double> subtreeCost(n);
+    vector<size_t> leaves(n), nodes(n);
+    vector<char> collapsed(n, 0), removed(n, 0);
+    vector<PruneStep> steps;
+    double alpha = 0;
+    while(true) {
+        fill(subtreeCost.begin(), subtreeCost.end(), 0.0);
+        fill(leaves.begin(), leaves.end(), 0);
+        fill(nodes.begin(), nodes.end(), 0);
+        for(size_t i = 0; i < n; i++) { //bottom up: a leaf or collapsed node counts as one leaf
+            if(entries[i].node->isLeaf || collapsed[i]) {
+                subtreeCost[i] = entries[i].leafCost;
+                leaves[i] = 1;
+                nodes[i] = 1;
+            } else {
+                nodes[i]++;
+            }
+            if(entries[i].parent >= 0) {
+                subtreeCost[entries[i].parent] += subtreeCost[i];
+                leaves[entries[i].parent] += leaves[i];
+                nodes[entries[i].parent] += nodes[i];
+            }
+        }
+        PruneStep step = {alpha, leaves[n - 1], nodes[n - 1], 0.0};
+        if(steps.size() > 1 && steps.back().alpha >= alpha)
+            steps.back() = step; //several links went at the same alpha (step 0 stays the untouched tree)
+        else
+            steps.push_back(step);
+        if(leaves[n - 1] == 1)
+            break;
+
+        for(size_t i = n; i-- > 0; ) //top down: everything under a collapsed node is gone
+            removed[i] = entries[i].parent >= 0 && (collapsed[entries[i].parent] || removed[entries[i].parent]);
+        double weakest = numeric_limits<double>::infinity();
+        vector<double> linkCost(n, numeric_limits<double>::infinity());
+        for(size_t i = 0; i < n; i++) {
+            if(entries[i].node->isLeaf || collapsed[i] || removed[i])
+                continue;
+            linkCost[i] = (entries[i].leafCost - subtreeCost[i]) / (double)max<size_t>(1, leaves[i] - 1); //one leaf below: free to collapse
+            weakest = min(weakest, linkCost[i]);
+        }
+        alpha = max(alpha, weakest); //never goes down, rounding aside
+        for(size_t i = 0; i < n; i++) {
+            if(linkCost[i] <= weakest + 1e-12) {
+                collapsed[i] = 1;
+                entries[i].alpha = alpha;
+            }
+        }
+    }
+
+    //validation accuracy of every step: a row stops at the first node on its path collapsed by the step's alpha
+    //walking down, node k is where it stops for alpha in [alpha_k, min alpha above k), which is a range of steps;
+    //step 0 collapses nothing, even links that cost nothing, so ranges start at step 1
+    vector<double> alphas(steps.size() - 1);
+    for(size_t s = 1; s < steps.size(); s++)
+        alphas[s - 1] = steps[s].alpha;
+    auto firstStep = [&alphas](double a) { return 1 + (size_t)(lower_bound(alphas.begin(), alphas.end(), a) - alphas.begin()); };
+    vector<long long> correct(steps.size() + 1, 0); //difference array over the steps
+    const uint32_t* labels = data.columns[labelIndex].codes.data();
+    for(uint32_t row : validationRows) {
+        double above = numeric_limits<double>::infinity(); //smallest alpha on the path so far
+        const Node* node = tree.root;
+        while(true) {
+            const Entry& e = entries[indexOf[node]];
+            bool right;
+            const Node* next = nullptr;
+            if(node->isLeaf) {
+                right = labels[row] == node->label;
+            } else {
+                next = node->child(branchOfRow(node, data, row));
+                if(e.alpha < above) { //collapsed before anything above it: counts as a leaf for alpha in [e.alpha, above)
+                    bool asLeaf = labels[row] == majorityOf(node->classCounts, numClasses);
+                    correct[firstStep(e.alpha)] += asLeaf;
+                    correct[firstStep(above)] -= asLeaf;
+                    above = e.alpha;
+                }
+                right = labels[row] == node->label; //fallback if there is no branch
+            }
+            if(next == nullptr) { //the row ends here for every alpha below the path minimum
+                correct[0] += right;
+                correct[firstStep(above)] -= right;
+                break;
+            }
+            node = next;
+        }
+    }
+    size_t best = 0;
+    long long running = 0;
+    for(size_t s = 0; s < steps.size(); s++) {
+        running += correct[s];
+        steps[s].accuracy = validationRows.empty() ? 0.0 : 100.0 * running / validationRows.size();
+        if(steps[s].accuracy >= steps[best].accuracy)
+            best = s;
+    }
+
+    for(size_t i = 0; i < n && best > 0; i++) //prune to the chosen alpha
+        if(!entries[i].node->isLeaf && entries[i].alpha <= steps[best].alpha)
+            makeLeaf(entries[i].node, numClasses);
+    return steps;
+}
+
+//splits rows into the part kept for training and a shuffled share held out for pruning
+void holdOutRows(vector<uint32_t>& rows, double fraction, uint32_t seed, vector<uint32_t>& heldOut) {
+    mt19937 g(seed);
+    shuffle(rows.begin(), rows.end(), g);
+    size_t keep = rows.size() - (size_t)(rows.size() * fraction);
+    heldOut.assign(rows.begin() + keep, rows.end());
+    rows.resize(keep);
+}
+
+//prunes tree with the chosen method and prints node count against accuracy, method 1 = reduced error, 2 = cost complexity
+void pruneAndReport(DecisionTree& tree, const Dataset& data, int labelIndex, const vector<uint32_t>& validationRows, int method) {
+    size_t before = countNodes(tree.root);
+    double accuracyBefore = calculateAccuracy(flattenTree(tree.root), data, validationRows, labelIndex);
+    auto start = chrono::steady_clock::now();
+    if(method == 1) {
+        reducedErrorPrune(tree, data, labelIndex, validationRows);
+        cout << "\nReduced error pruning on " << validationRows.size() << " validation rows\n";
+    } else {
+        vector<PruneStep> steps = costComplexityPrune(tree, data, labelIndex, validationRows);
+        cout << "\nCost complexity sweep on " << validationRows.size() << " validation rows (" << steps.size() << " trees)\n";
+        cout << "       Alpha  Leaves   Nodes  Validation\n" << fixed;
+        size_t stride = max<size_t>(1, steps.size() / 20); //about 20 lines however long the sweep is
+        for(size_t s = 0; s < steps.size(); s++) {
+            if(s % stride != 0 && s + 1 != steps.size())
+                continue;
+            cout << setprecision(6) << setw(12) << steps[s].alpha << setw(8) << steps[s].leaves << setw(8) << steps[s].nodes
+                 << setprecision(3) << setw(11) << steps[s].accuracy << "%\n";
+        }
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t after = countNodes(tree.root);
+    cout << "Pruned " << before << " -> " << after << " nodes, validation accuracy " << accuracyBefore << "% -> "
+         << calculateAccuracy(flattenTree(tree.root), data, validationRows, labelIndex) << "% in " << seconds * 1000 << " ms\n";
+}
+
+//Cross validation
+struct FoldResult { //outcome of one fold
+    int fold;
+    size_t trainRows;
+    size_t testRows;
+    size_t nodes;
+    double buildSeconds;
+    double accuracy; //percent of the fold's rows predicted correctly by the tree trained on the other folds
+};
+
+//k-fold cross validation on stratified folds, every fold's tree is trained on the other k-1 folds
+//the folds share the one loaded dataset (they only hold row numbers) and are built at the same time,
+//each on threads / k threads; the trees and accuracies do not depend on the number of threads
+vector<FoldResult> crossValidate(const Dataset& data, const vector<int>& featureIndices, int labelIndex, const string& metric,
+                                 const vector<string>& attributeNames, const TrainOptions& options, int k,
+                                 int threads, uint32_t seed = DEFAULT_SEED) {
+    vector<vector<uint32_t>> folds = stratifiedFolds(data, labelIndex, k, seed);
+    vector<FoldResult> results(k);
+    int numWorkers = max(1, min(threads, k));
+    atomic<int> nextFold(0);
+    auto work = [&] {
+        for(int f = nextFold++; f < k; f = nextFold++) {
+            vector<uint32_t> trainRows;
+            for(int g = 0; g < k; g++) {
+                if(g != f)
+                    trainRows.insert(trainRows.end(), folds[g].begin(), folds[g].end());
+            }
+            TrainOptions foldOptions = options;
+            foldOptions.threads = max(1, threads / numWorkers);
+            auto start = chrono::steady_clock::now();
+            DecisionTree tree = buildTree(data, trainRows, featureIndices, labelIndex, metric, attributeNames, foldOptions);
+            auto end = chrono::steady_clock::now();
+            FlatTree flat = flattenTree(tree.root);
+
+            FoldResult& result = results[f];
+            result.fold = f + 1;
+            result.trainRows = trainRows.size();
+            result.testRows = folds[f].size();
+            result.nodes = flat.size();
+            result.buildSeconds = chrono::duration<double>(end - start).count();
+            result.accuracy = calculateAccuracy(flat, data, folds[f], labelIndex);
+        }
+    };
+    vector<thread> workers;
+    for(int w = 1; w < numWorkers; w++)
+        workers.emplace_back(work);
+    work();
+    for(auto& w : workers)
+        w.join();
+    return results;
+}
+
+//runs k-fold cross validation and prints a line per fold and the mean accuracy, for the menu and for train --folds
+void reportCrossValidation(const Dataset& data, const vector<int>& featureIndices, int labelIndex, const string& metric,
+                           const vector<string>& attributeNames, const TrainOptions& options, int k,
+                           int threads, uint32_t seed = DEFAULT_SEED) {
+    auto start = chrono::high_resolution_clock::now();
+    vector<FoldResult> results = crossValidate(data, featureIndices, labelIndex, metric, attributeNames, options,
+                                               k, threads, seed);
+    auto end = chrono::high_resolution_clock::now();
+    double meanAccuracy = 0, meanSeconds = 0;
+    cout << "\nFold   Train    Test   Nodes  Build(s)  Accuracy\n" << fixed << setprecision(3);
+    for(const FoldResult& r : results) {
+        cout << setw(4) << r.fold << setw(8) << r.trainRows << setw(8) << r.testRows << setw(8) << r.nodes
+             << setw(10) << r.buildSeconds << setw(9) << r.accuracy << "%\n";
+        meanAccuracy += r.accuracy / k;
+        meanSeconds += r.buildSeconds / k;
+    }
+    double spread = 0;
+    for(const FoldResult& r : results)
+        spread += (r.accuracy - meanAccuracy) * (r.accuracy - meanAccuracy) / k;
+    cout << "Mean accuracy " << meanAccuracy << "% (std " << sqrt(spread) << "), mean build " << meanSeconds
+         << " s, wall time " << chrono::duration<double>(end - start).count() << " s\n";
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+}
+
+//Random forest
+struct ForestOptions { //settings of one forest training run
+    int numTrees;
+    int featuresPerSplit; //features scored at every node, 0 picks sqrt of the number of features
+    int threads;          //trees are built concurrently, one per thread
+    uint64_t seed;        //tree t uses mixSeed(seed, t) for its bootstrap sample and its feature subsets
+    TrainOptions tree;    //depth and histogram settings shared by every tree
+
+    ForestOptions() : numTrees(50), featuresPerSplit(0), threads(1), seed(1) {}
+};
+
+struct Forest { //bagged trees that vote on every prediction
+    vector<FlatTree> flat; //only the compiled trees are kept, each node arena is freed once its tree is flattened
+    uint32_t numClasses;
+
+    Forest() : numClasses(0) {}
+};
+
+//draws a bootstrap sample of rows as multiplicities (how many times every row was drawn) and returns it as an
+//index list in row order, so a row drawn k times just appears k times and no cells are copied
+vector<uint32_t> bootstrapRows(const vector<uint32_t>& rows, uint64_t seed) {
+    mt19937_64 rng(seed);
+    vector<uint32_t> multiplicity(rows.size(), 0);
+    for(size_t i = 0; i < rows.size(); i++)
+        multiplicity[rng() % rows.size()]++;
+    vector<uint32_t> sample;
+    sample.reserve(rows.size());
+    for(size_t i = 0; i < rows.size(); i++)
+        sample.insert(sample.end(), multiplicity[i], rows[i]);
+    return sample;
+}
+
+//trains options.numTrees trees on bootstrap samples of rows, each scoring a random subset of the features at every split
+//the threads take the next unbuilt tree until none are left; every tree only depends on its own seed,
+//so the forest is the same for any number of threads
+Forest trainForest(const Dataset& data, const vector<uint32_t>& rows, const vector<int>& featureIndices,
+                   int labelIndex, const string& metric, const vector<string>& attributeNames, const ForestOptions& options) {
+    Forest forest;
+    forest.numClasses = data.columns[labelIndex].cardinality();
+    forest.flat.resize(options.numTrees);
+
+    int featuresPerSplit = options.featuresPerSplit;
+    if(featuresPerSplit <= 0)
+        featuresPerSplit = max(1, (int)lround(sqrt((double)featureIndices.size())));
+    int numWorkers = max(1, min(options.threads, options.numTrees));
+
+    atomic<int> nextTree(0);
+    auto work = [&] {
+        for(int t = nextTree++; t < options.numTrees; t = nextTree++) {
+            TrainOptions treeOptions = options.tree;
+            treeOptions.threads = max(1, options.threads / numWorkers); //spare threads go to the trees when there are few of them
+            treeOptions.featuresPerSplit = featuresPerSplit;
+            treeOptions.seed = mixSeed(options.seed, (uint64_t)t);
+            DecisionTree tree = buildTree(data, bootstrapRows(rows, treeOptions.seed), featureIndices, labelIndex, metric,
+                                          attributeNames, treeOptions);
+            forest.flat[t] = flattenTree(tree.root); //tree and its arena go away at the end of the iteration
+        }
+    };
+    vector<thread> workers;
+    for(int w = 1; w < numWorkers; w++)
+        workers.emplace_back(work);
+    work();
+    for(auto& w : workers)
+        w.join();
+    return forest;
+}
+
+//majority vote of the forest for every given row (the smallest label code wins a tie, trees that predict unknown abstain)
+//every tree reads a block of rows straight from the dataset columns with predictColumns, and the block's votes are
+//added up before the next block, so the rows and their votes stay in cache across the trees
+vector<uint32_t> predictRows(const Forest& forest, const Dataset& data, const vector<uint32_t>& rows) {
+    const size_t blockRows = min<size_t>(1024, rows.size()); //votes of one block stay in cache while every tree predicts it
+    vector<const uint32_t*> columns;
+    columnWords(data, columns);
+    vector<uint32_t> treeOut(blockRows);
+    vector<uint32_t> votes(blockRows * forest.numClasses);
+    vector<uint32_t> predictions(rows.size());
+    for(size_t start = 0; start < rows.size(); start += blockRows) {
+        size_t count = min(blockRows, rows.size() - start);
+        fill(votes.begin(), votes.end(), 0);
+        for(const FlatTree& tree : forest.flat) {
+            predictColumns(tree, columns.data(), rows.data() + start, count, treeOut.data());
+            for(size_t i = 0; i < count; i++) {
+                if(treeOut[i] < forest.numClasses)
+                    votes[i * forest.numClasses + treeOut[i]]++;
+            }
+        }
+        for(size_t i = 0; i < count; i++) {
+            const uint32_t* rowVotes = votes.data() + i * forest.numClasses;
+            uint32_t best = UNKNOWN_CODE;
+            uint32_t bestVotes = 0;
+            for(uint32_t c = 0; c < forest.numClasses; c++) {
+                if(rowVotes[c] > bestVotes) {
+                    bestVotes = rowVotes[c];
+                    best = c;
+                }
+            }
+            predictions[start + i] = best;
+        }
+    }
+    return predictions;
+}
+
+//Streaming training
+//trains on files larger than memory: rows are never stored, every pass reads the file one chunk of whole lines at a time
+//pass 0 learns the schema (dictionaries, column types and numeric bin bounds), then every further pass counts the
+//(bin or code) x class histograms of a group of open nodes on one level and splits them with the histogram mode scorer
+const size_t SKETCH_EXACT_VALUES = 1024; //numeric columns with at most this many distinct values get exactly the bins of binColumn
+const size_t SKETCH_SAMPLE = 8192;       //bins of columns with more values come from a reservoir sample of this size
+
+struct StreamOptions { //settings of one streaming run
+    int maxDepth;
+    size_t memoryBudget;  //bytes for the chunk buffer and the node histograms of one pass
+    double trainFraction; //a row trains if a hash of its line number says so, the others are held out
+    uint64_t seed;
+    int maxBins;
+    char delimiter;
+
+    StreamOptions() : maxDepth(8), memoryBudget((size_t)256 << 20), trainFraction(0.7), seed(1), maxBins(255), delimiter(',') {}
+};
+
+struct StreamModel { //everything a streaming run keeps in memory: the schema and the tree, never the rows
+    Dataset schema;                                     //columns carry their dictionary or bin bounds, numRows is 0
+    vector<unordered_map<string_view, uint32_t>> lookup; //categorical column -> text -> code, views into schema
+    vector<uint32_t> emptyCode;                         //code (or bin) of an empty cell, used for columns a line is too short for
+    DecisionTree tree;
+    FlatTree flat;
+    size_t numRows;
+    size_t trainRows;
+    int passes; //full reads of the file, the schema pass included
+
+    StreamModel() : numRows(0), trainRows(0), passes(0) {}
+};
+
+bool isTrainRow(uint64_t row, const StreamOptions& options) { //the same row always lands on the same side of the split
+    return (double)(mixSeed(options.seed, row) >> 11) / 9007199254740992.0 < options.trainFraction;
+}
+
+class ChunkReader { //reads a text file one block of whole lines at a time, the block is kept until the next call
+public:
+    ChunkReader(const string& filename, size_t chunkBytes) : file(filename, ios::binary), opened((bool)file),
+                                                            chunkBytes(chunkBytes) {}
+
+    bool isOpen() const { return opened; }
+
+    bool next(char delimiter, ParsedChunk& chunk) { //false at the end of the file
+        buffer.swap(carry); //the partial line left over from the last block
+        carry.clear();
+        while(file) {
+            size_t old = buffer.size();
+            buffer.resize(old + chunkBytes);
+            file.read(&buffer[old], chunkBytes);
+            buffer.resize(old + (size_t)file.gcount());
+            size_t cut = buffer.rfind('\n');
+            if(file && cut != string::npos) { //keep the partial last line for the next block
+                carry.assign(buffer, cut + 1, string::npos);
+                buffer.resize(cut + 1);
+                break;
+            }
+        }
+        if(buffer.empty())
+            return false;
+        chunk = ParsedChunk();
+        parseLines(buffer.data(), 0, buffer.size(), delimiter, chunk);
+        return true;
+    }
+
+private:
+    ifstream file;
+    bool opened;
+    size_t chunkBytes;
+    string buffer; //the current block, the chunk's cells point into it
+    string carry;
+};
+
+struct ColumnSketch { //what the schema pass learns about one column
+    unordered_set<string> values; //distinct texts, dropped once a numeric column has too many
+    bool tracking;                //values is still complete
+    bool allNumeric;              //every value so far was a number or missing
+    bool anyNumber;
+    map<float, size_t> numberCounts; //distinct numbers and their row counts, while there are few
+    bool exact;
+    vector<float> sample; //reservoir sample of the numbers
+    size_t numbersSeen;
+
+    ColumnSketch() : tracking(true), allNumeric(true), anyNumber(false), exact(true), numbersSeen(0) {}
+};
+
+//turns the local codes of a chunk into model codes: the dictionary code of a categorical cell, the bin of a numeric one
+//(numBins for missing), and for numeric columns the value itself in numbers
+void remapChunk(const StreamModel& model, const ParsedChunk& chunk, vector<vector<uint32_t>>& codes, vector<vector<float>>& numbers) {
+    size_t numColumns = model.schema.columns.size();
+    codes.resize(numColumns);
+    numbers.resize(numColumns);
+    for(size_t c = 0; c < numColumns && c < chunk.codes.size(); c++) {
+        const Column& column = model.schema.columns[c];
+        codes[c].resize(chunk.values[c].size());
+        numbers[c].assign(chunk.values[c].size(), numeric_limits<float>::quiet_NaN());
+        for(size_t local = 0; local < chunk.values[c].size(); local++) {
+            string_view text = chunk.values[c][local];
+            if(column.numeric) {
+                parseNumber(string(text), numbers[c][local]); //leaves NaN for a missing (or unexpected) value
+                float x = numbers[c][local];
+                codes[c][local] = std::isnan(x) ? column.numBins()
+                                  : (uint32_t)(lower_bound(column.binUpper.begin(), column.binUpper.end(), x) - column.binUpper.begin());
+            } else {
+                auto it = model.lookup[c].find(text);
+                codes[c][local] = it == model.lookup[c].end() ? UNKNOWN_CODE : it->second;
+            }
+        }
+    }
+}
+
+//schema pass: reads the file once and fills model.schema, model.lookup and the row counts
+void learnSchema(const string& filename, int labelIndex, const StreamOptions& options, size_t chunkBytes, StreamModel& model) {
+    ChunkReader reader(filename, chunkBytes);
+    if(!reader.isOpen()) {
+        cerr << "Error opening file: " << filename << endl;
+        exit(1);
+    }
+    vector<ColumnSketch> sketches;
+    size_t minWidth = SIZE_MAX; //narrowest chunk, its missing columns are empty cells
+    mt19937_64 rng(options.seed);
+    ParsedChunk chunk;
+    while(reader.next(options.delimiter, chunk)) {
+        if(chunk.numRows == 0)
+            continue;
+        for(size_t r = 0; r < chunk.numRows; r++)
+            model.trainRows += isTrainRow(model.numRows + r, options);
+        model.numRows += chunk.numRows;
+        minWidth = min(minWidth, chunk.codes.size());
+        if(sketches.size() < chunk.codes.size())
+            sketches.resize(chunk.codes.size());
+
+        for(size_t c = 0; c < chunk.codes.size(); c++) {
+            ColumnSketch& sketch = sketches[c];
+            vector<float> parsed(chunk.values[c].size(), numeric_limits<float>::quiet_NaN());
+            vector<size_t> rowsWith(chunk.values[c].size(), 0);
+            for(uint32_t local : chunk.codes[c])
+                rowsWith[local]++;
+            for(size_t local = 0; local < chunk.values[c].size(); local++) {
+                string text(chunk.values[c][local]);
+                bool isNumber = parseNumber(text, parsed[local]);
+                if(!isNumber && !isMissing(text) && sketch.tracking) //once the texts are dropped a stray word counts as missing
+                    sketch.allNumeric = false;
+                if(sketch.tracking)
+                    sketch.values.insert(text);
+                if(isNumber && sketch.allNumeric) {
+                    sketch.anyNumber = true;
+                    if(sketch.exact)
+                        sketch.numberCounts[parsed[local]] += rowsWith[local];
+                }
+            }
+            if(!sketch.allNumeric)
+                continue;
+            if(sketch.exact && sketch.numberCounts.size() > SKETCH_EXACT_VALUES) {
+                sketch.exact = false;
+                sketch.numberCounts.clear();
+            }
+            if(sketch.tracking && (int)c != labelIndex && sketch.values.size() > SKETCH_EXACT_VALUES) {
+                sketch.tracking = false;
+                sketch.values.clear();
+            }
+            for(uint32_t local : chunk.codes[c]) { //reservoir sampling (algorithm R)
+                float x = parsed[local];
+                if(std::isnan(x))
+                    continue;
+                sketch.numbersSeen++;
+                if(sketch.sample.size() < SKETCH_SAMPLE)
+                    sketch.sample.push_back(x);
+                else if(rng() % sketch.numbersSeen < SKETCH_SAMPLE)
+                    sketch.sample[rng() % SKETCH_SAMPLE] = x;
+            }
+        }
+    }
+
+    Dataset& schema = model.schema;
+    schema.columns.resize(sketches.size());
+    model.lookup.resize(sketches.size());
+    model.emptyCode.assign(sketches.size(), UNKNOWN_CODE);
+    for(size_t c = 0; c < sketches.size(); c++) {
+        ColumnSketch& sketch = sketches[c];
+        Column& column = schema.columns[c];
+        if(minWidth <= c && sketch.tracking)
+            sketch.values.insert(string());
+        if((int)c != labelIndex && sketch.allNumeric && sketch.anyNumber) {
+            column.numeric = true;
+            vector<float> distinct;
+            vector<size_t> counts;
+            size_t total = 0;
+            if(sketch.exact) {
+                for(auto& pair : sketch.numberCounts) {
+                    distinct.push_back(pair.first);
+                    counts.push_back(pair.second);
+                    total += pair.second;
+                }
+            } else {
+                sort(sketch.sample.begin(), sketch.sample.end());
+                for(float x : sketch.sample) {
+                    if(distinct.empty() || distinct.back() != x) {
+                        distinct.push_back(x);
+                        counts.push_back(0);
+                    }
+                    counts.back()++;
+                }
+                total = sketch.sample.size();
+            }
+            column.binUpper = binBoundaries(distinct, counts, total, options.maxBins);
+            model.emptyCode[c] = column.numBins();
+        } else {
+            column.values.assign(sketch.values.begin(), sketch.values.end());
+            sort(column.values.begin(), column.values.end()); //same code order as the in memory loader
+        }
+    }
+    for(size_t c = 0; c < schema.columns.size(); c++) { //views into the final strings
+        const Column& column = schema.columns[c];
+        for(uint32_t code = 0; code < (uint32_t)column.values.size(); code++)
+            model.lookup[c].emplace(column.values[code], code);
+        if(!column.numeric && model.lookup[c].count(string_view()))
+            model.emptyCode[c] = model.lookup[c][string_view()];
+    }
+    model.passes = 1;
+}
+
+
+//the stopping rules of buildSubtree on a node's class counts; true if the node was made a leaf
+bool finishAsLeaf(Node* node, const int* classCounts, uint32_t numClasses, bool noFeatures, int depth, int maxDepth) {
+    uint32_t present = 0;
+    for(uint32_t c = 0; c < numClasses; c++)
+        present += classCounts[c] > 0;
+    if(present > 1 && !noFeatures && depth < maxDepth)
+        return false;
+    node->isLeaf = true;
+    node->label = majorityOf(classCounts, numClasses); //unknown for an empty node, the single class for a pure one
+    return true;
+}
+
+//trains a tree on a file without loading it: one schema pass, then one pass per group of open nodes per level
+//a group holds as many nodes as have histograms that fit in the memory budget next to the chunk buffer,
+//so a smaller budget means more passes but never more memory; the model and the dictionaries come on top
+//with exact bins (few distinct values per numeric column) the tree equals buildTree in histogram mode on the same rows
+template <typename Criterion>
+StreamModel trainStreaming(const string& filename, int labelIndex, const vector<string>& attributeNames, const StreamOptions& options) {
+    size_t chunkBytes = max<size_t>(64 << 10, options.memoryBudget / 8);
+    StreamModel model;
+    learnSchema(filename, labelIndex, options, chunkBytes, model);
+    const Dataset& schema = model.schema;
+    if(labelIndex < 0 || labelIndex >= (int)schema.columns.size()) {
+        cerr << "Label column " << labelIndex << " is missing from " << filename << "\n";
+        exit(1);
+    }
+    uint32_t numClasses = schema.columns[labelIndex].cardinality();
+
+    vector<int> featureIndices;
+    vector<size_t> histOffset(schema.columns.size(), 0);
+    size_t histSize = 0;
+    for(int f = 0; f < (int)schema.columns.size(); f++) {
+        if(f == labelIndex)
+            continue;
+        featureIndices.push_back(f);
+        histOffset[f] = histSize;
+        histSize += (size_t)histWidth(schema, f) * numClasses;
+    }
+    size_t nodeBytes = (histSize + numClasses) * sizeof(int);
+    size_t parseBytes = 4 * chunkBytes; //the block, its cells and the remapped codes
+    size_t nodesPerPass = max<size_t>(1, (options.memoryBudget > parseBytes ? options.memoryBudget - parseBytes : 0) / nodeBytes);
+
+    vector<vector<uint32_t>> noSorted;
+    vector<uint32_t> noRows;
+    BuildContext ctx = {schema, labelIndex, attributeNames, options.maxDepth, nullptr, 0,
+                        noSorted, noRows, noRows, true, histOffset, histSize, *model.tree.arena, 0};
+
+    struct OpenNode { //a node whose split is decided in the next pass
+        Node* node;
+        vector<int> features;
+        int depth;
+    };
+    model.tree.root = model.tree.arena->make<Node>();
+    vector<OpenNode> open(1, OpenNode{model.tree.root, featureIndices, 0});
+    vector<vector<uint32_t>> codes;
+    vector<vector<float>> numbers;
+    ParsedChunk chunk;
+    while(!open.empty()) {
+        vector<OpenNode> next; //the open nodes of the next level
+        for(size_t first = 0; first < open.size(); first += nodesPerPass) {
+            size_t groupSize = min(nodesPerPass, open.size() - first);
+            unordered_map<const Node*, uint32_t> slotOf;
+            for(uint32_t s = 0; s < (uint32_t)groupSize; s++)
+                slotOf[open[first + s].node] = s;
+            vector<int> hists(groupSize * histSize, 0);
+            vector<int> classCounts(groupSize * numClasses, 0);
+
+            ChunkReader reader(filename, chunkBytes);
+            size_t row = 0;
+            while(reader.next(options.delimiter, chunk)) {
+                remapChunk(model, chunk, codes, numbers);
+                auto cell = [&](size_t c, size_t r) {
+                    return c < chunk.codes.size() ? codes[c][chunk.codes[c][r]] : model.emptyCode[c];
+                };
+                for(size_t r = 0; r < chunk.numRows; r++, row++) {
+                    if(!isTrainRow(row, options))
+                        continue;
+                    const Node* node = model.tree.root;
+                    while(node != nullptr && !node->isLeaf && node->numChildren > 0) { //walk down to the open node of this row
+                        uint32_t value = cell(node->featureIndex, r);
+                        if(node->numeric) {
+                            const Column& column = schema.columns[node->featureIndex];
+                            value = value < column.numBins() && column.binUpper[value] <= node->threshold ? 0 : 1;
+                        }
+                        node = node->child(value);
+                    }
+                    auto slot = node == nullptr ? slotOf.end() : slotOf.find(node);
+                    if(slot == slotOf.end()) //the row is in a finished part of the tree or in another group
+                        continue;
+                    uint32_t label = cell(labelIndex, r);
+                    classCounts[(size_t)slot->second * numClasses + label]++;
+                    int* hist = hists.data() + (size_t)slot->second * histSize;
+                    for(int f : open[first + slot->second].features)
+                        hist[histOffset[f] + (size_t)cell(f, r) * numClasses + label]++;
+                }
+            }
+            model.passes++;
+
+            for(size_t s = 0; s < groupSize; s++) { //split every node of the group on its histogram
+                OpenNode& item = open[first + s];
+                Node* node = item.node;
+                const int* counts = classCounts.data() + s * numClasses;
+                const int* hist = hists.data() + s * histSize;
+                if(finishAsLeaf(node, counts, numClasses, item.features.empty(), item.depth, options.maxDepth))
+                    continue;
+
+                double bestScore = -1e9;
+                int bestFeature = -1;
+                float bestThreshold = 0.0f;
+                CountTable table;
+                for(int f : item.features) { //same order and tie breaking as buildSubtree
+                    float threshold = 0.0f;
+                    double score = scoreFeature<Criterion>(ctx, table, noRows, 0, 0, f, threshold, hist);
+                    if(score > bestScore) {
+                        bestScore = score;
+                        bestFeature = f;
+                        bestThreshold = threshold;
+                    }
+                }
+                if(bestFeature == -1) {
+                    node->isLeaf = true;
+                    node->label = majorityOf(counts, numClasses);
+                    continue;
+                }
+                const Column& column = schema.columns[bestFeature];
+                node->featureIndex = bestFeature;
+                node->featureName = model.tree.arena->copyString(attributeNames[bestFeature]);
+                node->numeric = column.numeric;
+                node->threshold = bestThreshold;
+
+                uint32_t numBranches = column.numeric ? 2 : column.cardinality();
+                vector<int> branchCounts((size_t)numBranches * numClasses, 0); //class counts of every child, read off the histogram
+                const int* cells = hist + histOffset[bestFeature];
+                for(uint32_t v = 0; v < histWidth(schema, bestFeature); v++) {
+                    uint32_t branch = v;
+                    if(column.numeric)
+                        branch = v < column.numBins() && column.binUpper[v] <= bestThreshold ? 0 : 1;
+                    for(uint32_t c = 0; c < numClasses; c++)
+                        branchCounts[(size_t)branch * numClasses + c] += cells[(size_t)v * numClasses + c];
+                }
+                vector<int> remainingFeatures;
+                for(int f : item.features) {
+                    if(f != bestFeature || column.numeric)
+                        remainingFeatures.push_back(f);
+                }
+
+                vector<Node*> childNodes(numBranches, nullptr);
+                for(uint32_t b = 0; b < numBranches; b++) {
+                    const int* childCounts = branchCounts.data() + (size_t)b * numClasses;
+                    if(majorityOf(childCounts, numClasses) == UNKNOWN_CODE) //no rows took this branch
+                        continue;
+                    childNodes[b] = model.tree.arena->make<Node>();
+                    if(!finishAsLeaf(childNodes[b], childCounts, numClasses, remainingFeatures.empty(), item.depth + 1, options.maxDepth))
+                        next.push_back(OpenNode{childNodes[b], remainingFeatures, item.depth + 1});
+                }
+                uint32_t numChildNodes = numBranches;
+                while(numChildNodes > 0 && childNodes[numChildNodes - 1] == nullptr)
+                    numChildNodes--;
+                node->children = model.tree.arena->makeArray<Node*>(numChildNodes);
+                node->numChildren = numChildNodes;
+                copy(childNodes.begin(), childNodes.begin() + numChildNodes, node->children);
+            }
+        }
+        open = move(next);
+    }
+    model.flat = flattenTree(model.tree.root);
+    return model;
+}
+
+StreamModel trainStreaming(const string& filename, int labelIndex, const string& metric,
+                           const vector<string>& attributeNames, const StreamOptions& options) { //picks the criterion once
+    return withCriterion(metric, [&](auto criterion) {
+        return trainStreaming<decltype(criterion)>(filename, labelIndex, attributeNames, options);
+    });
+}
+
+//one more pass that predicts every row of the file with the streamed model
+//returns the accuracy (in percent) on the held out rows and writes "SampleID,Actual,Predicted" lines to out if it is not null
+double streamPredictions(const string& filename, const StreamModel& model, int labelIndex, const StreamOptions& options,
+                         BufferedWriter* out) {
+    size_t chunkBytes = max<size_t>(64 << 10, options.memoryBudget / 8);
+    ChunkReader reader(filename, chunkBytes);
+    size_t numColumns = model.schema.columns.size();
+    vector<vector<uint32_t>> codes;
+    vector<vector<float>> numbers;
+    vector<Cell> cells;
+    vector<uint32_t> predictions;
+    ParsedChunk chunk;
+    size_t row = 0, heldOut = 0, correct = 0;
+    if(out)
+        out->write("SampleID,Actual,Predicted\n");
+    while(reader.next(options.delimiter, chunk)) {
+        remapChunk(model, chunk, codes, numbers);
+        cells.resize(chunk.numRows * numColumns);
+        for(size_t c = 0; c < numColumns; c++) {
+            bool numeric = model.schema.columns[c].numeric;
+            for(size_t r = 0; r < chunk.numRows; r++) {
+                Cell& cell = cells[r * numColumns + c];
+                if(c >= chunk.codes.size()) {
+                    if(numeric)
+                        cell.number = numeric_limits<float>::quiet_NaN();
+                    else
+                        cell.code = model.emptyCode[c];
+                } else if(numeric) {
+                    cell.number = numbers[c][chunk.codes[c][r]];
+                } else {
+                    cell.code = codes[c][chunk.codes[c][r]];
+                }
+            }
+        }
+        predictions.resize(chunk.numRows);
+        predictBatch(model.flat, cells.data(), chunk.numRows, numColumns, predictions.data());
+        for(size_t r = 0; r < chunk.numRows; r++, row++) {
+            uint32_t actual = cells[r * numColumns + labelIndex].code;
+            if(!isTrainRow(row, options)) {
+                heldOut++;
+                correct += predictions[r] == actual;
+            }
+            if(out)
+                writePredictionLine(*out, row + 1, model.schema.decode(labelIndex, actual), model.schema.decode(labelIndex, predictions[r]));
+        }
+    }
+    return heldOut == 0 ? 0.0 : (double)correct / heldOut * 100.0;
+}
+
+//Online training
+//a Hoeffding tree (VFDT) learns from one row at a time: every leaf keeps the (bin or code) x class counts of the rows
+//that reached it, and once it has seen enough of them to be confident (the Hoeffding bound) that its best split is
+//better than the runner up, it splits into empty leaves; a row costs one walk down the tree plus one count per feature
+struct HoeffdingOptions { //settings of an online tree
+    double delta;        //allowed probability of choosing the wrong split
+    double tieThreshold; //split anyway once the bound is this small, the two best splits are then equally good
+    int gracePeriod;     //rows a leaf sees between split attempts
+    int maxDepth;
+
+    HoeffdingOptions() : delta(1e-7), tieThreshold(0.05), gracePeriod(200), maxDepth(8) {}
+};
+
+struct OnlineNode { //one node of a HoeffdingTree
+    int32_t feature;     //column the node splits on, -1 for a leaf
+    bool numeric;
+    float threshold;     //numeric split: value <= threshold takes branch 0
+    uint32_t label;      //leaf: its prediction; split node: answer for a value it has no branch for
+    uint32_t childBegin; //first entry of this node's branches in the children array
+    uint32_t childCount;
+    int32_t leaf;        //leaves: index of their LeafStats
+    int depth;
+};
+
+struct LeafStats { //sufficient statistics of one leaf
+    vector<int> labelCounts; //rows per class, decides the leaf's label (seeded with the branch counts of the split that made it)
+    vector<int> classCounts; //rows per class counted into hist
+    vector<int> hist;        //node histogram over the features in features, laid out by histOffset
+    vector<int> features;    //features the leaf may still split on (empty at maxDepth)
+    int rows;                //rows counted into hist
+    int sinceCheck;          //rows since the last split attempt
+};
+
+template <typename Criterion>
+class HoeffdingTree {
+public:
+    //schema needs its numeric columns binned (binNumericColumns), candidate thresholds are the bin bounds
+    HoeffdingTree(const Dataset& schema, int labelIndex, const vector<string>& attributeNames,
+                  const HoeffdingOptions& options = HoeffdingOptions())
+        : schema(schema), labelIndex(labelIndex), attributeNames(attributeNames), options(options),
+          histOffset(schema.columns.size(), 0), histSize(0), numClasses(schema.columns[labelIndex].cardinality()), rowsSeen(0) {
+        for(int f = 0; f < (int)schema.columns.size(); f++) {
+            if(f == labelIndex)
+                continue;
+            if(schema.columns[f].numeric && schema.columns[f].binUpper.empty()) {
+                cerr << "Online training needs binNumericColumns to be called after loading\n";
+                exit(1);
+            }
+            allFeatures.push_back(f);
+            histOffset[f] = histSize;
+            histSize += (size_t)histWidth(schema, f) * numClasses;
+        }
+        nodes.push_back(makeLeaf(UNKNOWN_CODE, 0, allFeatures));
+    }
+
+    //starts from a tree made by buildTree instead of a single leaf: the splits are copied, every leaf keeps learning,
+    //and the training rows are counted into the leaves so their labels stay what the batch build gave them
+    void seed(const Node* root, const Dataset& data, const vector<uint32_t>& rows) {
+        nodes.clear();
+        children.clear();
+        leaves.clear();
+        freeLeaves.clear();
+        copySubtree(root, UNKNOWN_CODE, 0, allFeatures);
+        vector<Cell> cells(schema.columns.size());
+        for(uint32_t r : rows) {
+            encodeRows(data, &r, 1, cells.data());
+            uint32_t n = descend(cells.data());
+            uint32_t label = cells[labelIndex].code;
+            if(nodes[n].feature < 0 && label < numClasses)
+                leaves[nodes[n].leaf].labelCounts[label]++;
+        }
+    }
+
+    void learn(const Cell* row) { //absorbs one row
+        uint32_t label = row[labelIndex].code;
+        if(label >= numClasses)
+            return;
+        rowsSeen++;
+        uint32_t n = descend(row);
+        if(nodes[n].feature >= 0) //a categorical value the split has no branch for
+            return;
+        LeafStats& stats = leaves[nodes[n].leaf];
+        int count = ++stats.labelCounts[label];
+        uint32_t current = nodes[n].label;
+        if(current >= numClasses || count > stats.labelCounts[current] || (count == stats.labelCounts[current] && label < current))
+            nodes[n].label = label; //majority label, the smallest code wins a tie
+        if(stats.features.empty())
+            return;
+        stats.classCounts[label]++;
+        stats.rows++;
+        for(int f : stats.features) {
+            uint32_t value = valueOf(row, f);
+            if(value < histWidth(schema, f))
+                stats.hist[histOffset[f] + (size_t)value * numClasses + label]++;
+        }
+        if(++stats.sinceCheck >= options.gracePeriod) {
+            stats.sinceCheck = 0;
+            trySplit(n);
+        }
+    }
+
+    FlatTree flatten() const { //the same tree in the layout the batch kernels and model files use
+        auto arrays = make_shared<FlatTreeArrays>();
+        size_t numericSplits = 0;
+        for(const OnlineNode& node : nodes) {
+            FlatNode fn;
+            fn.feature = node.feature;
+            fn.label = node.label;
+            fn.childBegin = node.childBegin;
+            fn.childCount = node.childCount;
+            fn.threshold = node.feature >= 0 && node.numeric ? node.threshold : numeric_limits<float>::quiet_NaN();
+            fn.numeric = node.feature >= 0 && node.numeric ? 1 : 0;
+            numericSplits += fn.numeric;
+            arrays->nodes.push_back(fn);
+        }
+        arrays->childTable = children;
+        FlatTree tree;
+        tree.nodes = arrays->nodes.data();
+        tree.numNodes = arrays->nodes.size();
+        tree.childTable = arrays->childTable.data();
+        tree.childTableSize = arrays->childTable.size();
+        tree.numericSplits = numericSplits;
+        tree.storage = arrays;
+        return tree;
+    }
+
+    size_t size() const { return nodes.size(); }
+    size_t rowsLearned() const { return rowsSeen; }
+
+private:
+    const Dataset& schema;
+    int labelIndex;
+    const vector<string>& attributeNames;
+    HoeffdingOptions options;
+    vector<int> allFeatures;
+    vector<size_t> histOffset;
+    size_t histSize;
+    uint32_t numClasses;
+    size_t rowsSeen;
+    vector<OnlineNode> nodes; //nodes[0] is the root
+    vector<uint32_t> children;
+    vector<LeafStats> leaves;
+    vector<int32_t> freeLeaves; //statistics slots of leaves that have split
+
+    uint32_t valueOf(const Cell* row, int f) const { //histogram row of a cell: its code, or its bin (numBins if missing)
+        const Column& column = schema.columns[f];
+        if(!column.numeric)
+            return row[f].code;
+        float x = row[f].number;
+        if(std::isnan(x))
+            return column.numBins();
+        return (uint32_t)(lower_bound(column.binUpper.begin(), column.binUpper.end(), x) - column.binUpper.begin());
+    }
+
+    uint32_t descend(const Cell* row) const { //index of the leaf the row reaches, or of the split node it gets stuck at
+        uint32_t n = 0;
+        while(nodes[n].feature >= 0) {
+            const OnlineNode& node = nodes[n];
+            uint32_t branch = node.numeric ? (row[node.feature].number <= node.threshold ? 0 : 1) : row[node.feature].code;
+            if(branch >= node.childCount)
+                return n;
+            n = children[node.childBegin + branch];
+        }
+        return n;
+    }
+
+    OnlineNode makeLeaf(uint32_t label, int depth, const vector<int>& features) {
+        int32_t slot;
+        if(freeLeaves.empty()) {
+            slot = (int32_t)leaves.size();
+            leaves.emplace_back();
+        } else {
+            slot = freeLeaves.back();
+            freeLeaves.pop_back();
+        }
+        LeafStats& stats = leaves[slot];
+        stats.labelCounts.assign(numClasses, 0);
+        stats.rows = 0;
+        stats.sinceCheck = 0;
+        if(depth < options.maxDepth && !features.empty()) {
+            stats.features = features;
+            stats.classCounts.assign(numClasses, 0);
+            stats.hist.assign(histSize, 0);
+        } else { //a leaf that can never split only needs its label counts
+            stats.features.clear();
+            stats.classCounts.clear();
+            stats.hist.clear();
+        }
+        OnlineNode node;
+        node.feature = -1;
+        node.numeric = false;
+        node.threshold = 0.0f;
+        node.label = label;
+        node.childBegin = 0;
+        node.childCount = 0;
+        node.leaf = slot;
+        node.depth = depth;
+        return node;
+    }
+
+    uint32_t copySubtree(const Node* source, uint32_t label, int depth, const vector<int>& features) {
+        uint32_t n = (uint32_t)nodes.size();
+        if(source == nullptr || source->isLeaf) {
+            nodes.push_back(makeLeaf(source ? source->label : label, depth, features));
+            return n;
+        }
+        const Column& column = schema.columns[source->featureIndex];
+        OnlineNode node;
+        node.feature = source->featureIndex;
+        node.numeric = source->numeric;
+        node.threshold = source->threshold;
+        node.label = fallbackLabel(source); //what the flat tree answers for a branch without a child
+        node.childCount = source->numeric ? 2 : column.cardinality();
+        node.childBegin = (uint32_t)children.size();
+        node.leaf = -1;
+        node.depth = depth;
+        nodes.push_back(node);
+        children.resize(children.size() + node.childCount, 0);
+        vector<int> remaining;
+        for(int f : features) {
+            if(f != source->featureIndex || source->numeric)
+                remaining.push_back(f);
+        }
+        for(uint32_t b = 0; b < node.childCount; b++) { //a branch the batch tree never saw becomes an empty leaf
+            uint32_t child = copySubtree(source->child(b), node.label, depth + 1, remaining);
+            children[node.childBegin + b] = child;
+        }
+        return n;
+    }
+
+    void trySplit(uint32_t n) {
+        LeafStats& stats = leaves[nodes[n].leaf];
+        uint32_t present = 0;
+        for(uint32_t c = 0; c < numClasses; c++)
+            present += stats.classCounts[c] > 0;
+        if(present < 2) //a pure leaf has nothing to gain
+            return;
+
+        vector<vector<uint32_t>> noSorted;
+        vector<uint32_t> noRows;
+        NodeArena unused; //scoring never allocates nodes
+        BuildContext ctx = {schema, labelIndex, attributeNames, options.maxDepth, nullptr, 0,
+                            noSorted, noRows, noRows, true, histOffset, histSize, unused, 0};
+        CountTable table;
+        table.load(stats.classCounts.data(), 1, numClasses);
+        double noSplit = Criterion::score(table); //score of keeping the leaf
+        double best = -numeric_limits<double>::infinity(), second = noSplit;
+        int bestFeature = -1;
+        float bestThreshold = 0.0f;
+        for(int f : stats.features) { //features in order, so ties go to the same feature as in the batch build
+            float threshold = 0.0f;
+            double score = scoreFeature<Criterion>(ctx, table, noRows, 0, 0, f, threshold, stats.hist.data());
+            if(score > best) {
+                second = max(second, best);
+                best = score;
+                bestFeature = f;
+                bestThreshold = threshold;
+            } else {
+                second = max(second, score);
+            }
+        }
+        if(bestFeature == -1 || best <= noSplit)
+            return;
+
+        double range = Criterion::range(numClasses); //largest possible difference of two scores
+        double bound = sqrt(range * range * log(1.0 / options.delta) / (2.0 * stats.rows));
+        if(best - second <= bound && bound >= options.tieThreshold)
+            return;
+        split(n, bestFeature, bestThreshold);
+    }
+
+    void split(uint32_t n, int f, float threshold) {
+        const Column& column = schema.columns[f];
+        int32_t slot = nodes[n].leaf;
+        vector<int> remaining;
+        for(int g : leaves[slot].features) {
+            if(g != f || column.numeric)
+                remaining.push_back(g);
+        }
+        uint32_t numBranches = column.numeric ? 2 : column.cardinality();
+        vector<int> branchCounts((size_t)numBranches * numClasses, 0); //class counts per branch, read off the histogram
+        const int* cells = leaves[slot].hist.data() + histOffset[f];
+        for(uint32_t v = 0; v < histWidth(schema, f); v++) {
+            uint32_t branch = v;
+            if(column.numeric)
+                branch = v < column.numBins() && column.binUpper[v] <= threshold ? 0 : 1;
+            for(uint32_t c = 0; c < numClasses; c++)
+                branchCounts[(size_t)branch * numClasses + c] += cells[(size_t)v * numClasses + c];
+        }
+        uint32_t parentLabel = nodes[n].label;
+        int depth = nodes[n].depth;
+        vector<int>().swap(leaves[slot].hist); //the statistics of a split node are not needed any more
+        vector<int>().swap(leaves[slot].classCounts);
+        freeLeaves.push_back(slot);
+
+        OnlineNode& node = nodes[n];
+        node.feature = f;
+        node.numeric = column.numeric;
+        node.threshold = threshold;
+        node.childBegin = (uint32_t)children.size();
+        node.childCount = numBranches;
+        node.leaf = -1;
+        for(uint32_t b = 0; b < numBranches; b++) {
+            const int* counts = branchCounts.data() + (size_t)b * numClasses;
+            uint32_t label = majorityOf(counts, numClasses);
+            OnlineNode leaf = makeLeaf(label == UNKNOWN_CODE ? parentLabel : label, depth + 1, remaining);
+            copy(counts, counts + numClasses, leaves[leaf.leaf].labelCounts.begin());
+            children.push_back((uint32_t)nodes.size());
+            nodes.push_back(leaf);
+        }
+    }
+};
+
+//Model files
+//a saved model is a fixed header followed by a payload of 8 byte aligned sections:
+//  FlatNode nodes[numNodes], uint32_t childTable[childTableSize], ModelColumn columns[numColumns],
+//  then for every column its name and (categorical columns only) its sorted dictionary as
+//  uint64_t offsets[numValues + 1] into the characters that follow them
+//every array is used in place, so loading is one mmap plus a checksum and a bounds check pass, nothing is parsed or allocated per node
+const char MODEL_MAGIC[8] = {'D', 'T', 'M', 'O', 'D', 'E', 'L', '\0'};
+const uint32_t MODEL_VERSION = 1;
+const uint32_t MODEL_BYTE_ORDER = 0x01020304; //reads differently on a machine with the other byte order
+
+struct ModelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t headerSize;   //sizeof(ModelHeader) of the writer
+    uint32_t numColumns;
+    int32_t labelIndex;
+    uint32_t reserved;
+    uint64_t schemaHash;   //column count, label, names and types the model was trained on
+    uint64_t numNodes;
+    uint64_t childTableSize;
+    uint64_t numericSplits;
+    uint64_t payloadSize;
+    uint64_t checksum;     //FNV-1a of the payload
+};
+
+struct ModelColumn { //one column of the training schema inside a model file
+    uint32_t numeric;     //1 if the column was numeric
+    uint32_t numValues;   //dictionary size of a categorical column
+    uint64_t nameOffset;  //payload offset of the name characters
+    uint64_t nameLength;
+    uint64_t valuesOffset; //payload offset of the uint64_t offsets array of the dictionary
+};
+
+uint64_t fnv1a(const void* bytes, size_t size, uint64_t hash = 14695981039346656037ull) { //64 bit FNV-1a hash
+    const unsigned char* p = (const unsigned char*)bytes;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+//fingerprint of the columns a model expects: how many there are, which one is the label,
+//and the name and type of each, so a model is never applied to data with a different layout
+uint64_t schemaHash(const vector<string>& names, const vector<bool>& numeric, int labelIndex) {
+    uint64_t hash = fnv1a(&labelIndex, sizeof(labelIndex));
+    uint64_t numColumns = numeric.size();
+    hash = fnv1a(&numColumns, sizeof(numColumns), hash);
+    for(size_t c = 0; c < numeric.size(); c++) {
+        const string& name = c < names.size() ? names[c] : string();
+        uint64_t length = name.size();
+        uint8_t type = numeric[c] ? 1 : 0;
+        hash = fnv1a(&length, sizeof(length), hash);
+        hash = fnv1a(name.data(), name.size(), hash);
+        hash = fnv1a(&type, sizeof(type), hash);
+    }
+    return hash;
+}
+
+uint64_t schemaHash(const Dataset& data, const vector<string>& attributeNames, int labelIndex) {
+    vector<bool> numeric;
+    for(const auto& column : data.columns)
+        numeric.push_back(column.numeric);
+    return schemaHash(attributeNames, numeric, labelIndex);
+}
+
+//writes a flattened tree together with the dictionaries of the dataset it was trained on
+bool saveModel(const string& filename, const FlatTree& tree, const Dataset& data,
+               const vector<string>& attributeNames, int labelIndex) {
+    string payload;
+    auto align = [&payload]() { payload.resize((payload.size() + 7) & ~(size_t)7, '\0'); };
+    auto append = [&payload](const void* bytes, size_t size) { payload.append((const char*)bytes, size); };
+
+    append(tree.nodes, tree.numNodes * sizeof(FlatNode));
+    align();
+    append(tree.childTable, tree.childTableSize * sizeof(uint32_t));
+    align();
+
+    size_t columnsOffset = payload.size(); //column records are filled in once the strings are placed
+    vector<ModelColumn> columns(data.columns.size());
+    append(columns.data(), columns.size() * sizeof(ModelColumn));
+    align();
+
+    for(size_t c = 0; c < data.columns.size(); c++) {
+        const Column& column = data.columns[c];
+        const string& name = c < attributeNames.size() ? attributeNames[c] : string();
+        ModelColumn& mc = columns[c];
+        mc.numeric = column.numeric ? 1 : 0;
+        mc.numValues = column.numeric ? 0 : column.cardinality();
+        mc.nameOffset = payload.size();
+        mc.nameLength = name.size();
+        append(name.data(), name.size());
+        align();
+
+        mc.valuesOffset = payload.size();
+        if(column.numeric)
+            continue;
+        vector<uint64_t> offsets(1, 0);
+        for(const auto& value : column.values)
+            offsets.push_back(offsets.back() + value.size());
+        append(offsets.data(), offsets.size() * sizeof(uint64_t));
+        for(const auto& value : column.values)
+            append(value.data(), value.size());
+        align();
+    }
+    memcpy(&payload[columnsOffset], columns.data(), columns.size() * sizeof(ModelColumn));
+
+    ModelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+    header.version = MODEL_VERSION;
+    header.byteOrder = MODEL_BYTE_ORDER;
+    header.headerSize = sizeof(ModelHeader);
+    header.numColumns = (uint32_t)data.columns.size();
+    header.labelIndex = labelIndex;
+    header.schemaHash = schemaHash(data, attributeNames, labelIndex);
+    header.numNodes = tree.numNodes;
+    header.childTableSize = tree.childTableSize;
+    header.numericSplits = tree.numericSplits;
+    header.payloadSize = payload.size();
+    header.checksum = fnv1a(payload.data(), payload.size());
+
+    ofstream file(filename, ios::binary);
+    if(!file)
+        return false;
+    file.write((const char*)&header, sizeof(header));
+    file.write(payload.data(), payload.size());
+    return (bool)file;
+}
+
+//a model opened with loadModel: the tree and every dictionary point straight into the mapped file
+struct Model {
+    FlatTree tree;
+    int labelIndex;
+    uint64_t schema;
+    const ModelColumn* columns;
+    size_t numColumns;
+    const char* payload;
+
+    Model() : labelIndex(-1), schema(0), columns(nullptr), numColumns(0), payload(nullptr) {}
+
+    string_view columnName(size_t c) const {
+        return string_view(payload + columns[c].nameOffset, columns[c].nameLength);
+    }
+
+    bool numeric(size_t c) const { return columns[c].numeric != 0; }
+
+    uint32_t cardinality(size_t c) const { return columns[c].numValues; }
+
+    string_view value(size_t c, uint32_t code) const { //dictionary entry of a categorical column
+        if(code >= columns[c].numValues)
+            return "unknown";
+        const uint64_t* offsets = (const uint64_t*)(payload + columns[c].valuesOffset);
+        const char* chars = (const char*)(offsets + columns[c].numValues + 1);
+        return string_view(chars + offsets[code], offsets[code + 1] - offsets[code]);
+    }
+
+    string_view decodeLabel(uint32_t code) const { return value(labelIndex, code); }
+};
+
+//checks that every count, index and offset in a model stays inside its payload before anything follows them,
+//so a file that passes the checksum but was written wrong cannot make prediction read out of bounds or loop
+bool validModel(const ModelHeader& header, const char* payload) {
+    uint64_t size = header.payloadSize;
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t width) { //offset + count * width <= size without overflow
+        return offset <= size && count <= (size - offset) / width;
+    };
+    if(header.numNodes == 0 || !fits(0, header.numNodes, sizeof(FlatNode)))
+        return false;
+    uint64_t childOffset = (header.numNodes * sizeof(FlatNode) + 7) & ~(uint64_t)7;
+    if(!fits(childOffset, header.childTableSize, sizeof(uint32_t)))
+        return false;
+    uint64_t columnsOffset = (childOffset + header.childTableSize * sizeof(uint32_t) + 7) & ~(uint64_t)7;
+    if(!fits(columnsOffset, header.numColumns, sizeof(ModelColumn))
+       || header.labelIndex < 0 || (uint32_t)header.labelIndex >= header.numColumns)
+        return false;
+
+    const ModelColumn* columns = (const ModelColumn*)(payload + columnsOffset);
+    for(uint32_t c = 0; c < header.numColumns; c++) {
+        const ModelColumn& column = columns[c];
+        if(column.numeric > 1 || !fits(column.nameOffset, column.nameLength, 1))
+            return false;
+        if(column.numeric) {
+            if(column.numValues != 0 || (uint32_t)header.labelIndex == c)
+                return false;
+            continue;
+        }
+        if(column.valuesOffset % sizeof(uint64_t) != 0 || !fits(column.valuesOffset, column.numValues + 1ull, sizeof(uint64_t)))
+            return false;
+        const uint64_t* offsets = (const uint64_t*)(payload + column.valuesOffset);
+        uint64_t charsOffset = column.valuesOffset + (column.numValues + 1ull) * sizeof(uint64_t);
+        if(offsets[0] != 0)
+            return false;
+        for(uint32_t v = 0; v < column.numValues; v++) { //value v is chars[offsets[v], offsets[v + 1])
+            if(offsets[v + 1] < offsets[v])
+                return false;
+        }
+        if(!fits(charsOffset, offsets[column.numValues], 1))
+            return false;
+    }
+
+    const FlatNode* nodes = (const FlatNode*)payload;
+    const uint32_t* childTable = (const uint32_t*)(payload + childOffset);
+    uint32_t numLabels = columns[header.labelIndex].numValues;
+    uint64_t numericSplits = 0;
+    for(uint64_t i = 0; i < header.numNodes; i++) {
+        const FlatNode& node = nodes[i];
+        if(node.label >= numLabels && node.label != UNKNOWN_CODE)
+            return false;
+        if(node.feature < 0) { //a leaf branches nowhere
+            if(node.feature != -1 || node.childCount != 0 || node.numeric != 0 || !std::isnan(node.threshold))
+                return false;
+            continue;
+        }
+        if((uint32_t)node.feature >= header.numColumns || node.feature == header.labelIndex
+           || node.numeric != columns[node.feature].numeric || (node.numeric && node.childCount != 2)
+           || node.childCount == 0 || node.childBegin + (uint64_t)node.childCount > header.childTableSize)
+            return false;
+        if(node.numeric ? !std::isfinite(node.threshold) : !std::isnan(node.threshold)) //the AVX2 kernel tells the kinds apart by NaN
+            return false;
+        numericSplits += node.numeric;
+        for(uint32_t b = 0; b < node.childCount; b++) { //children come after their parent, so every walk ends at a leaf
+            uint32_t child = childTable[node.childBegin + b];
+            if(child != NO_CHILD && (child <= i || child >= header.numNodes))
+                return false;
+        }
+    }
+    return numericSplits == header.numericSplits;
+}
+
+//maps a model file and checks it before use
+//the file is rejected if the magic, version or byte order differ, if it is truncated or corrupted (checksum),
+//or if expectedSchema is not 0 and the model was trained on a different schema
+bool loadModel(const string& filename, Model& model, string& error, uint64_t expectedSchema = 0) {
+    auto file = make_shared<MappedFile>();
+    if(!file->open(filename)) {
+        error = "cannot open " + filename;
+        return false;
+    }
+    if(file->size() < sizeof(ModelHeader)) {
+        error = filename + " is too small to be a model";
+        return false;
+    }
+    const ModelHeader& header = *(const ModelHeader*)file->data();
+    if(memcmp(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0) {
+        error = filename + " is not a model file";
+        return false;
+    }
+    if(header.version != MODEL_VERSION || header.byteOrder != MODEL_BYTE_ORDER || header.headerSize != sizeof(ModelHeader)) {
+        error = filename + " was written by an incompatible version or machine";
+        return false;
+    }
+    if(header.payloadSize != file->size() - sizeof(ModelHeader)) {
+        error = filename + " is truncated";
+        return false;
+    }
+    const char* payload = file->data() + sizeof(ModelHeader);
+    if(fnv1a(payload, header.payloadSize) != header.checksum) {
+        error = filename + " failed its checksum";
+        return false;
+    }
+    if(expectedSchema != 0 && header.schemaHash != expectedSchema) {
+        error = filename + " was trained on a different schema";
+        return false;
+    }
+
+    if(!validModel(header, payload)) {
+        error = filename + " has an invalid layout";
+        return false;
+    }
+    size_t childOffset = (header.numNodes * sizeof(FlatNode) + 7) & ~(size_t)7;
+    size_t columnsOffset = (childOffset + header.childTableSize * sizeof(uint32_t) + 7) & ~(size_t)7;
+
+    model = Model();
+    model.tree.nodes = (const FlatNode*)payload;
+    model.tree.numNodes = header.numNodes;
+    model.tree.childTable = (const uint32_t*)(payload + childOffset);
+    model.tree.childTableSize = header.childTableSize;
+    model.tree.numericSplits = header.numericSplits;
+    model.tree.storage = file;
+    model.labelIndex = header.labelIndex;
+    model.schema = header.schemaHash;
+    model.columns = (const ModelColumn*)(payload + columnsOffset);
+    model.numColumns = header.numColumns;
+    model.payload = payload;
+    return true;
+}
+
+//Datasets
+struct DatasetInfo { //one of the UCI datasets the program knows by number
+    const char* title;
+    const char* file;
+    vector<string> attributeNames;
+    string labelName;
+    size_t rows; //rows in the real file, the benchmark makes this many synthetic ones
+    const char* synthetic; //column kinds for the generator: cN = N categories, iA:B = ints, nA:B = reals, *K repeats
+};
+
+const vector<DatasetInfo>& knownDatasets() {
+    static const vector<DatasetInfo> datasets = {
+        {"Thyroid Dataset", "Thyroid_Diff.csv",
+         {"Age","Gender", "Smoking","Hx_Smoking","Hx_Radiotherapy","Thyroid_Function","Physical_examination","Adenopathy","Pathology","Focality","Risk", "T", "N", "M","Stage", "Response", "Target"},
+         "Target", 383, "i15:82 c2*4 c5 c5 c6 c4 c2 c3 c7 c3 c2 c5 c4 c2"},
+        {"Adult", "adult.data",
+         {"age", "workclass", "fnlwgt", "education", "education-num",
+          "marital-status", "occupation", "relationship", "race", "sex",
+          "capital-gain", "capital-loss", "hours-per-week", "native-country",
+          "income"},
+         "income", 32561, "i17:90 c9 i12285:1484705 c16 i1:16 c7 c15 c6 c5 c2 i0:99999 i0:4356 i1:99 c42 c2"},
+        {"Mushroom", "agaricus-lepiota.data",
+         {"class", "cap-shape","cap-surface","cap-color","bruises","odor",
+          "gill-attachment","gill-spacing","gill-size","gill-color",
+          "stalk-shape","stalk-root","stalk-surface-above-ring",
+          "stalk-surface-below-ring","stalk-color-above-ring",
+          "stalk-color-below-ring","veil-type","veil-color","ring-number",
+          "ring-type","spore-print-color","population","habitat"},
+         "class", 8124, "c2 c6 c4 c10 c2 c9 c2 c2 c2 c12 c2 c5 c4 c4 c9 c9 c1 c4 c3 c5 c9 c6 c7"},
+        {"Car Evaluation", "car.data",
+         {"buying", "maint", "doors", "persons", "lug_boot", "safety", "evaluation"},
+         "evaluation", 1728, "c4 c4 c4 c3 c3 c3 c4"},
+        {"Nursery", "nursery.data",
+         {"parents","has_nurs","form","children","housing",
+          "finance","social","health","evaluation"},
+         "evaluation", 12960, "c3 c5 c4 c4 c3 c2 c3 c3 c5"},
+        {"Letter Recognition", "letter-recognition.data",
+         {"letter", "x-box", "y-box","width","high","onpix","x-bar",
+          "y-bar","x2bar","y2bar","xybar","x2ybr","xy2br",
+          "x-ege","xegvy","y-ege","yegvx"},
+         "letter", 20000, "c26 i0:15*16"},
+        {"Chess (KR vs KP)", "krkopt.data",
+         {"white-king-file", "white-king-rank", "white-rook-file",
+          "white-rook-rank", "black-king-file", "black-king-rank", "outcome"},
+         "outcome", 28056, "c8 i1:8 c8 i1:8 c8 i1:8 c18"},
+        {"Pen-Based Recognition", "pen_based.data",
+         {"x1","x2","x3","x4","x5","x6","x7","x8","x9","x10",
+          "x11","x12","x13","x14","x15","x16","digit"},
+         "digit", 10992, "i0:100*16 c10"},
+        {"Tic-Tac-Toe", "tic-tac-toe.data",
+         {"top-left", "top-middle", "top-right",
+          "middle-left", "middle-middle", "middle-right",
+          "bottom-left", "bottom-middle", "bottom-right",
+          "outcome"},
+         "outcome", 958, "c3*9 c2"},
+        {"Test Dataset (Play Tennis)", "test.data",
+         {"Outlook", "Temperature", "Humidity", "Wind", "PlayTennis"},
+         "PlayTennis", 14, "c3 c3 c2 c2 c2"},
+        {"Student Data", "students.data",
+         {"marital_status", "application_mode", "application_order", "course",
+          "daytime_evening_attendance", "previous_qualification", "previous_qualification_grade",
+          "nationality", "mothers_qualification", "fathers_qualification", "mothers_occupation",
+          "fathers_occupation", "admission_grade", "displaced", "educational_special_needs",
+          "debtor", "tuition_fees_up_to_date", "gender", "scholarship_holder", "age_at_enrollment",
+          "international", "curricular_units_1st_sem_credited", "curricular_units_1st_sem_enrolled",
+          "curricular_units_1st_sem_evaluations", "curricular_units_1st_sem_approved",
+          "curricular_units_1st_sem_grade", "curricular_units_1st_sem_without_evaluations",
+          "curricular_units_2nd_sem_credited", "curricular_units_2nd_sem_enrolled",
+          "curricular_units_2nd_sem_evaluations", "curricular_units_2nd_sem_approved",
+          "curricular_units_2nd_sem_grade", "curricular_units_2nd_sem_without_evaluations",
+          "unemployment_rate", "inflation_rate", "gdp", "target"},
+         "target", 4424, "i1:6 i1:57 i0:9 i33:9991 i0:1 i1:43 n95:190 i1:109 i1:44 i1:44 i0:194 i0:195 n95:190 "
+                         "i0:1*6 i17:70 i0:1 i0:20 i0:26 i0:45 i0:26 n0:19 i0:12 i0:20 i0:26 i0:45 i0:26 n0:19 i0:12 "
+                         "n7.6:16.2 n-0.8:3.7 n-4.06:3.51 c3"},
+    };
+    return datasets;
+}
+
+int findLabel(const vector<string>& attributeNames, const string& labelName) {
+    for(int i = 0; i < (int)attributeNames.size(); i++)
+        if(attributeNames[i] == labelName)
+            return i;
+    return -1;
+}
+
+//Benchmark
+struct SyntheticColumn { //how the generator fills one column
+    char kind; //'c' categorical, 'i' integer, 'n' real
+    int categories;
+    double low, high;
+};
+
+vector<SyntheticColumn> parseSynthetic(const char* spec) {
+    vector<SyntheticColumn> columns;
+    istringstream in(spec);
+    string token;
+    while(in >> token) {
+        int repeat = 1;
+        size_t star = token.find('*');
+        if(star != string::npos) {
+            repeat = stoi(token.substr(star + 1));
+            token.resize(star);
+        }
+        SyntheticColumn column = {token[0], 0, 0, 0};
+        if(column.kind == 'c') {
+            column.categories = stoi(token.substr(1));
+        } else {
+            size_t colon = token.find(':');
+            column.low = stod(token.substr(1, colon - 1));
+            column.high = stod(token.substr(colon + 1));
+        }
+        columns.insert(columns.end(), repeat, column);
+    }
+    return columns;
+}
+
+double unitRandom(mt19937_64& rng) { //uniform in [0, 1), the same on every standard library unlike uniform_real_distribution
+    return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double normalRandom(mt19937_64& rng) { //box muller, again so the data does not depend on the library
+    double u = 1.0 - unitRandom(rng);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * acos(-1.0) * unitRandom(rng));
+}
+
+//writes rows of random values with the dataset's column kinds
+//the label is the argmax of a random score per class plus noise, each feature adds a weight per category or a step at a random cut,
+//so the data has real structure for the tree to find instead of pure noise
+bool writeSyntheticData(const DatasetInfo& info, const string& filename, size_t numRows, uint64_t seed) {
+    vector<SyntheticColumn> columns = parseSynthetic(info.synthetic);
+    int labelIndex = findLabel(info.attributeNames, info.labelName);
+    if(columns.size() != info.attributeNames.size() || labelIndex < 0 || columns[labelIndex].kind != 'c')
+        return false;
+    int numClasses = columns[labelIndex].categories;
+
+    mt19937_64 rng(seed);
+    vector<vector<double>> weights(columns.size()); //weights[c][class * slots + value]
+    vector<double> cuts(columns.size());
+    for(size_t c = 0; c < columns.size(); c++) {
+        if((int)c == labelIndex)
+            continue;
+        int slots = columns[c].kind == 'c' ? columns[c].categories : 2; //numeric columns get one weight each side of the cut
+        weights[c].resize((size_t)numClasses * slots);
+        for(double& w : weights[c])
+            w = normalRandom(rng);
+        cuts[c] = columns[c].low + unitRandom(rng) * (columns[c].high - columns[c].low);
+    }
+
+    ofstream out(filename);
+    if(!out)
+        return false;
+    vector<double> score(numClasses);
+    vector<string> fields(columns.size());
+    for(size_t r = 0; r < numRows; r++) {
+        for(int k = 0; k < numClasses; k++)
+            score[k] = normalRandom(rng); //noise so the label is not a pure function of the row
+        for(size_t c = 0; c < columns.size(); c++) {
+            if((int)c == labelIndex)
+                continue;
+            const SyntheticColumn& column = columns[c];
+            int slot;
+            if(column.kind == 'c') {
+                slot = (int)(rng() % column.categories);
+                fields[c] = "v" + to_string(slot);
+            } else {
+                double value = column.low + unitRandom(rng) * (column.high - column.low);
+                if(column.kind == 'i') {
+                    value = floor(value + 0.5);
+                    fields[c] = to_string((long long)value);
+                } else {
+                    value = floor(value * 100 + 0.5) / 100; //two decimals like the real files
+                    ostringstream text;
+                    text << value;
+                    fields[c] = text.str();
+                }
+                slot = value <= cuts[c] ? 0 : 1;
+            }
+            int slots = column.kind == 'c' ? column.categories : 2;
+            for(int k = 0; k < numClasses; k++)
+                score[k] += weights[c][(size_t)k * slots + slot];
+        }
+        fields[labelIndex] = "class" + to_string(max_element(score.begin(), score.end()) - score.begin());
+        for(size_t c = 0; c < columns.size(); c++)
+            out << (c ? "," : "") << fields[c];
+        out << "\n";
+    }
+    return (bool)out;
+}
+
+//a new empty file under $TMPDIR (else /tmp) whose name starts with stem, so a run never overwrites a file of the user's
+//or of another run in the same directory; empty if it could not be created, the caller removes the file when done
+string makeTempFile(const string& stem) {
+#ifdef HAVE_MMAP
+    const char* dir = getenv("TMPDIR");
+    string path = string(dir != nullptr && *dir ? dir : "/tmp") + "/" + stem + ".XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if(fd < 0)
+        return string();
+    close(fd);
+    return path;
+#else
+    error_code error;
+    filesystem::path dir = filesystem::temp_directory_path(error);
+    if(error)
+        return string();
+    string path = (dir / (stem + "." + to_string(random_device()()))).string();
+    if(filesystem::exists(path) || !ofstream(path))
+        return string();
+    return path;
+#endif
+}
+
+struct BenchOptions {
+    double scale = 1.0; //synthetic rows per real row
+    int repeats = 3; //load and train are timed this many times and the median is kept
+    int threads = 1;
+    uint64_t seed = 1;
+    vector<int> datasets; //1 based numbers from the menu, empty means all of them
+    vector<string> metrics = {"gini", "info", "gain"};
+    string output = "bench.json";
+};
+
+struct BenchCell { //what one dataset and metric measured, plain data so a child process can send it back through a pipe
+    size_t rows = 0, columns = 0;
+    double loadMs = 0, trainMs = 0;
+    size_t nodes = 0;
+    double nodesPerSecond = 0;
+    double singleNs = 0, singleRowsPerSecond = 0; //mean time of one predict call
+    double batchNsPerRow = 0, batchRowsPerSecond = 0;
+    double accuracy = 0;
+};
+
+struct BenchResult { //one dataset and metric
+    string dataset, metric;
+    BenchCell cell;
+    long peakKB = 0; //peak rss of the child process that ran the cell, 0 where there is no fork
+};
+
+#ifdef HAVE_FORK
+const char* const BENCH_PEAK_RSS = "ru_maxrss of a child process per dataset and metric";
+#else
+const char* const BENCH_PEAK_RSS = "not measured";
+#endif
+
+template <typename F>
+double medianMs(int repeats, F&& run) {
+    vector<double> times;
+    for(int i = 0; i < repeats; i++) {
+        auto start = chrono::steady_clock::now();
+        run();
+        times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+template <typename F>
+double nsPerItem(size_t itemsPerCall, F&& run) { //repeats run until 50 ms have passed so short calls still time well
+    const double minSeconds = 0.05;
+    size_t calls = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        run();
+        calls++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while(elapsed < minSeconds);
+    return elapsed * 1e9 / ((double)calls * max<size_t>(1, itemsPerCall));
+}
+
+string jsonString(const string& s) {
+    string out = "\"";
+    for(char c : s) {
+        if(c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+void writeBenchJson(ostream& out, const BenchOptions& options, const vector<BenchResult>& results) {
+    out << "{\n  \"format\": 3,\n"; //bump if fields change meaning so old files are not compared by mistake
+    out << "  \"config\": {\"scale\": " << options.scale << ", \"repeats\": " << options.repeats
+        << ", \"threads\": " << options.threads << ", \"seed\": " << options.seed << ", \"compiler\": "
+#ifdef __VERSION__
+        << jsonString(__VERSION__)
+#else
+        << "\"unknown\""
+#endif
+        << ", \"hardware_threads\": " << thread::hardware_concurrency() << ", \"peak_rss\": " << jsonString(BENCH_PEAK_RSS) << "},\n";
+    out << "  \"results\": [\n" << fixed;
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        const BenchCell& c = r.cell;
+        out << "    {\"dataset\": " << jsonString(r.dataset) << ", \"metric\": " << jsonString(r.metric)
+            << ", \"rows\": " << c.rows << ", \"columns\": " << c.columns
+            << setprecision(3) << ", \"load_ms\": " << c.loadMs << ", \"train_ms\": " << c.trainMs
+            << ", \"nodes\": " << c.nodes << setprecision(0) << ", \"nodes_per_sec\": " << c.nodesPerSecond
+            << setprecision(1) << ", \"predict_single_ns\": " << c.singleNs
+            << setprecision(0) << ", \"predict_single_rows_per_sec\": " << c.singleRowsPerSecond
+            << setprecision(1) << ", \"predict_batch_ns_per_row\": " << c.batchNsPerRow
+            << setprecision(0) << ", \"predict_batch_rows_per_sec\": " << c.batchRowsPerSecond
+            << setprecision(3) << ", \"accuracy\": " << c.accuracy
+            << ", \"peak_rss_kb\": " << r.peakKB << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    out.unsetf(ios::floatfield);
+}
+
+//loads, trains and predicts one dataset with one metric
+BenchCell runBenchCell(const DatasetInfo& info, const string& filename, const string& metric, const BenchOptions& options) {
+    int labelIndex = findLabel(info.attributeNames, info.labelName);
+    BenchCell r;
+    Dataset data;
+    r.loadMs = medianMs(options.repeats, [&] { data = loadDataFile(filename, ',', labelIndex, options.threads); });
+    r.rows = data.size();
+    r.columns = data.columns.size();
+    vector<uint32_t> trainRows, testRows;
+    stratifiedSplit(data, labelIndex, trainRows, testRows, 0.7, (uint32_t)options.seed);
+    vector<int> featureIndices;
+    for(int i = 0; i < (int)data.columns.size(); i++)
+        if(i != labelIndex)
+            featureIndices.push_back(i);
+    TrainOptions trainOptions;
+    trainOptions.threads = options.threads;
+
+    FlatTree flat;
+    r.trainMs = medianMs(options.repeats, [&] {
+        DecisionTree tree = buildTree(data, trainRows, featureIndices, labelIndex, metric, info.attributeNames, trainOptions);
+        flat = flattenTree(tree.root);
+    });
+    r.nodes = flat.size();
+    r.nodesPerSecond = r.trainMs > 0 ? r.nodes / (r.trainMs / 1000) : 0;
+
+    volatile uint32_t sink = 0; //keeps the single row loop from being optimized away
+    r.singleNs = nsPerItem(testRows.size(), [&] {
+        uint32_t sum = 0;
+        for(uint32_t row : testRows)
+            sum += predict(flat, data, row);
+        sink = sink + sum;
+    });
+    r.singleRowsPerSecond = r.singleNs > 0 ? 1e9 / r.singleNs : 0;
+    vector<uint32_t> predictions(testRows.size()); //the caller's buffer, like the single row loop it is not timed
+    r.batchNsPerRow = nsPerItem(testRows.size(), [&] {
+        predictRows(flat, data, testRows.data(), testRows.size(), predictions.data());
+        sink = sink + (predictions.empty() ? 0 : predictions.back());
+    });
+    r.batchRowsPerSecond = r.batchNsPerRow > 0 ? 1e9 / r.batchNsPerRow : 0;
+    r.accuracy = calculateAccuracy(flat, data, testRows, labelIndex);
+    return r;
+}
+
+//runs one cell in a child process that sends its numbers back through a pipe; the child's ru_maxrss from wait4 is
+//then the peak of that cell alone (plus the pages it shares with the parent, which never loads a dataset itself),
+//where a peak of the one benchmark process would only ever grow from one cell to the next
+bool runBenchCellIsolated(const DatasetInfo& info, const string& filename, const string& metric, const BenchOptions& options,
+                          BenchResult& result) {
+#ifdef HAVE_FORK
+    int fds[2];
+    if(pipe(fds) != 0)
+        return false;
+    cout.flush(); //otherwise the child would write out what the parent has buffered as well
+    pid_t child = fork();
+    if(child < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if(child == 0) {
+        close(fds[0]);
+        BenchCell cell = runBenchCell(info, filename, metric, options);
+        const char* bytes = (const char*)&cell;
+        size_t sent = 0;
+        while(sent < sizeof(cell)) {
+            ssize_t n = write(fds[1], bytes + sent, sizeof(cell) - sent);
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                _exit(1);
+            sent += (size_t)n;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    char* bytes = (char*)&result.cell;
+    size_t received = 0;
+    while(received < sizeof(BenchCell)) {
+        ssize_t n = read(fds[0], bytes + received, sizeof(BenchCell) - received);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+        received += (size_t)n;
+    }
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    while(wait4(child, &status, 0, &usage) < 0) {
+        if(errno != EINTR)
+            return false;
+    }
+    if(received != sizeof(BenchCell) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return false;
+#ifdef __APPLE__
+    result.peakKB = usage.ru_maxrss / 1024; //bytes on macos
+#else
+    result.peakKB = usage.ru_maxrss;
+#endif
+    return true;
+#else
+    result.cell = runBenchCell(info, filename, metric, options);
+    return true;
+#endif
+}
+
+//non interactive benchmark over synthetic copies of every known dataset
+//the data only depends on the seed and scale, so two runs with the same flags can be diffed field by field
+int runBenchmark(const BenchOptions& options) {
+    const vector<DatasetInfo>& datasets = knownDatasets();
+    vector<int> chosen = options.datasets;
+    if(chosen.empty())
+        for(int d = 1; d <= (int)datasets.size(); d++)
+            chosen.push_back(d);
+
+    vector<BenchResult> results;
+    for(int d : chosen) {
+        if(d < 1 || d > (int)datasets.size()) {
+            cerr << "No dataset number " << d << "\n";
+            return 1;
+        }
+        const DatasetInfo& info = datasets[d - 1];
+        size_t numRows = max<size_t>(1, (size_t)(info.rows * options.scale + 0.5));
+        string filename = makeTempFile("bench_" + string(info.file));
+        if(filename.empty() || !writeSyntheticData(info, filename, numRows, mixSeed(options.seed, d))) {
+            cerr << "Error writing synthetic data for " << info.file << (filename.empty() ? "" : " to " + filename) << "\n";
+            if(!filename.empty())
+                remove(filename.c_str());
+            return 1;
+        }
+
+        for(const string& metric : options.metrics) {
+            BenchResult r;
+            r.dataset = info.file;
+            r.metric = metric;
+            if(!runBenchCellIsolated(info, filename, metric, options, r)) {
+                cerr << "The benchmark of " << info.file << " with " << metric << " did not finish\n";
+                remove(filename.c_str());
+                return 1;
+            }
+            results.push_back(r);
+
+            const BenchCell& c = r.cell;
+            cout << left << setw(26) << r.dataset << setw(6) << r.metric << right << fixed << setprecision(2)
+                 << " load " << setw(9) << c.loadMs << " ms  train " << setw(9) << c.trainMs << " ms  "
+                 << setw(7) << c.nodes << " nodes  single " << setw(7) << setprecision(1) << c.singleNs
+                 << " ns  batch " << setw(6) << c.batchNsPerRow << " ns/row  peak " << r.peakKB << " KB\n";
+            cout.unsetf(ios::floatfield);
+        }
+        remove(filename.c_str());
+    }
+
+    ofstream out(options.output);
+    if(!out) {
+        cerr << "Error opening " << options.output << " for writing\n";
+        return 1;
+    }
+    writeBenchJson(out, options, results);
+    cout << "Results written to " << options.output << "\n";
+    return 0;
+}
+
+//Tests
+//the test subcommand checks that the fast paths agree with the plain ones they replace; bench only measures
+
+struct TestReport { //counts the checks of a run and prints the ones that fail
+    int checks = 0, failed = 0;
+
+    void expect(bool ok, const string& what) {
+        checks++;
+        if(!ok) {
+            failed++;
+            cout << "FAIL " << what << "\n";
+        }
+    }
+};
+
+struct KernelCheck { //how far the criterion kernels are from the textbook formulas
+    size_t tables = 0;
+    double entropyError = 0, giniError = 0; //largest absolute differences seen
+    bool sameBits = true; //the scalar and the dispatched (AVX2 where there is one) sums were identical
+};
+
+//random count tables with every class and category count of the bundled datasets, from all small counts to ones
+//past the n log2 n table, scored by the kernels and by -sum p log2 p and 1 - sum p^2 as the old entropy and gini did
+KernelCheck checkCriterionKernels(uint64_t seed) {
+    vector<int> sizes;
+    for(const DatasetInfo& info : knownDatasets())
+        for(const SyntheticColumn& column : parseSynthetic(info.synthetic))
+            if(column.kind == 'c')
+                sizes.push_back(column.categories);
+    sort(sizes.begin(), sizes.end());
+    sizes.erase(unique(sizes.begin(), sizes.end()), sizes.end());
+    const int scales[] = {3, 100, 5000, 1000000, 50000000};
+    mt19937_64 rng(seed);
+    KernelCheck check;
+    vector<int> counts;
+    for(int n : sizes) {
+        counts.resize(n);
+        for(int t = 0; t < 2000; t++) {
+            int scale = scales[t % 5];
+            long long total = 0;
+            for(int& count : counts) {
+                count = rng() % 4 == 0 ? 0 : (int)(rng() % (scale + 1)); //some classes are empty
+                total += count;
+            }
+            if(total == 0 || total > numeric_limits<int>::max())
+                continue;
+            double entropy = 0, gini = 1;
+            for(int count : counts) {
+                double p = (double)count / total;
+                if(p > 0)
+                    entropy -= p * log2(p);
+                gini -= p * p;
+            }
+            check.tables++;
+            check.entropyError = max(check.entropyError, fabs(entropyFromCounts(counts.data(), n, (int)total) - entropy));
+            check.giniError = max(check.giniError, fabs(giniFromCounts(counts.data(), n, (int)total) - gini));
+            check.sameBits &= sumNLogN(counts.data(), n) == sumNLogNScalar(counts.data(), n)
+                              && sumSquares(counts.data(), n) == sumSquaresScalar(counts.data(), n);
+        }
+    }
+    return check;
+}
+
+struct TestOptions {
+    double scale = 0.25; //synthetic rows per real row, as in bench
+    int threads = 4; //the parallel side of the checks that compare against one thread
+    uint64_t seed = 1;
+    vector<int> datasets; //1 based numbers from the menu, empty means all of them
+};
+
+struct TestData { //one synthetic dataset, loaded and split once for every check that runs on it
+    const DatasetInfo* info = nullptr;
+    string file; //the synthetic csv, kept until the checks of this dataset are done
+    Dataset data;
+    int labelIndex = -1;
+    vector<uint32_t> trainRows, testRows;
+    vector<int> featureIndices;
+};
+
+//prunes a tree both ways, saves and reloads each pruned tree, and checks the loaded model predicts rows as the tree did
+void checkPrunedModels(const TestData& t, uint32_t seed, TestReport& report) {
+    vector<uint32_t> fitRows = t.trainRows, validationRows;
+    holdOutRows(fitRows, 0.25, seed, validationRows);
+    const string modelFile = makeTempFile("test_pruned.dtm");
+    if(modelFile.empty()) {
+        report.expect(false, "could not create a temporary model file");
+        return;
+    }
+    for(int method = 1; method <= 2; method++) {
+        DecisionTree tree = buildTree(t.data, fitRows, t.featureIndices, t.labelIndex, "gini", t.info->attributeNames);
+        if(method == 1)
+            reducedErrorPrune(tree, t.data, t.labelIndex, validationRows);
+        else
+            costComplexityPrune(tree, t.data, t.labelIndex, validationRows);
+        FlatTree flat = flattenTree(tree.root);
+        Model model;
+        string error;
+        bool same = saveModel(modelFile, flat, t.data, t.info->attributeNames, t.labelIndex) && loadModel(modelFile, model, error)
+                    && predictRows(model.tree, t.data, t.testRows) == predictRows(flat, t.data, t.testRows);
+        report.expect(same, string(t.info->file) + ": " + (method == 1 ? "reduced error" : "cost complexity")
+                            + " pruned model does not load back with the same predictions");
+    }
+    remove(modelFile.c_str());
+}
+
+//the holdout split and the folds must use every row once and give each class its share on every side:
+//round(0.7 n) of a class's n rows train, and a class's count in two folds differs by at most one
+void checkStratifiedSplits(const TestData& t, uint32_t seed, TestReport& report) {
+    const Column& label = t.data.columns[t.labelIndex];
+    uint32_t numClasses = label.cardinality();
+    vector<size_t> total(numClasses, 0), train(numClasses, 0);
+    for(uint32_t r = 0; r < (uint32_t)t.data.size(); r++)
+        total[label.codes[r]]++;
+    for(uint32_t r : t.trainRows)
+        train[label.codes[r]]++;
+    vector<uint32_t> all = t.trainRows;
+    all.insert(all.end(), t.testRows.begin(), t.testRows.end());
+    sort(all.begin(), all.end());
+    bool everyRowOnce = all.size() == t.data.size();
+    for(size_t i = 0; everyRowOnce && i < all.size(); i++)
+        everyRowOnce = all[i] == i;
+    report.expect(everyRowOnce, string(t.info->file) + ": the holdout split does not use every row once");
+    bool proportional = true;
+    for(uint32_t c = 0; c < numClasses; c++)
+        proportional &= train[c] == (size_t)(total[c] * 0.7 + 0.5);
+    report.expect(proportional, string(t.info->file) + ": the holdout split does not keep the class proportions");
+
+    const int k = 5;
+    vector<vector<uint32_t>> folds = stratifiedFolds(t.data, t.labelIndex, k, seed);
+    vector<size_t> low(numClasses, SIZE_MAX), high(numClasses, 0);
+    size_t rows = 0;
+    for(const auto& fold : folds) {
+        vector<size_t> count(numClasses, 0);
+        for(uint32_t r : fold)
+            count[label.codes[r]]++;
+        for(uint32_t c = 0; c < numClasses; c++) {
+            low[c] = min(low[c], count[c]);
+            high[c] = max(high[c], count[c]);
+        }
+        rows += fold.size();
+    }
+    bool balanced = rows == t.data.size();
+    for(uint32_t c = 0; c < numClasses; c++)
+        balanced &= high[c] - low[c] <= 1;
+    report.expect(balanced, string(t.info->file) + ": the cross validation folds do not keep the class proportions");
+}
+
+//every batch kernel must give each row the label the one row walk of predict gives it
+void checkBatchPredictions(const TestData& t, TestReport& report) {
+    DecisionTree tree = buildTree(t.data, t.trainRows, t.featureIndices, t.labelIndex, "gini", t.info->attributeNames);
+    FlatTree flat = flattenTree(tree.root);
+    const vector<uint32_t>& rows = t.testRows; //rows the tree never saw, so the fallback labels are walked too
+    string name = t.info->file;
+    vector<uint32_t> expected(rows.size()), out(rows.size());
+    for(size_t i = 0; i < rows.size(); i++)
+        expected[i] = predict(flat, t.data, rows[i]);
+
+    report.expect(predictRows(flat, t.data, rows) == expected, name + ": predictRows differs from predict");
+    vector<const uint32_t*> columns;
+    columnWords(t.data, columns);
+    predictColumns(flat, columns.data(), rows.data(), rows.size(), out.data()); //predictRows walks short lists one row at a time
+    report.expect(out == expected, name + ": predictColumns differs from predict");
+
+    size_t stride = t.data.columns.size();
+    vector<Cell> cells(rows.size() * stride);
+    encodeRows(t.data, rows.data(), rows.size(), cells.data());
+    predictBatchScalar(flat, cells.data(), rows.size(), stride, out.data());
+    report.expect(out == expected, name + ": predictBatchScalar differs from predict");
+    predictBatch(flat, cells.data(), rows.size(), stride, out.data());
+    report.expect(out == expected, name + ": predictBatch differs from predict");
+#ifdef HAVE_AVX2_KERNELS
+    if(cpuHasAvx2) { //predictBatch only takes the AVX2 kernel for trees with threshold splits
+        predictBatchAvx2(flat, cells.data(), rows.size(), stride, out.data());
+        report.expect(out == expected, name + ": predictBatchAvx2 differs from predict");
+    }
+#endif
+}
+
+bool sameFlatTree(const FlatTree& a, const FlatTree& b) { //node for node and branch for branch, thresholds bit for bit
+    return a.numNodes == b.numNodes && a.childTableSize == b.childTableSize
+           && memcmp(a.nodes, b.nodes, a.numNodes * sizeof(FlatNode)) == 0
+           && memcmp(a.childTable, b.childTable, a.childTableSize * sizeof(uint32_t)) == 0;
+}
+
+//a tree must not depend on the number of threads that built it, with exact and with histogram scoring;
+//the parallel cutoff is lowered so the small synthetic datasets really are split across the threads
+void checkThreadedTrees(const TestData& t, int threads, TestReport& report) {
+    Dataset binned = t.data;
+    binNumericColumns(binned);
+    for(bool histogram : {false, true}) {
+        TrainOptions serial, parallel;
+        serial.histogram = parallel.histogram = histogram;
+        parallel.threads = threads;
+        parallel.parallelCutoff = 64;
+        for(const char* metric : {"gini", "info", "gain"}) {
+            DecisionTree one = buildTree(binned, t.trainRows, t.featureIndices, t.labelIndex, metric, t.info->attributeNames, serial);
+            DecisionTree many = buildTree(binned, t.trainRows, t.featureIndices, t.labelIndex, metric, t.info->attributeNames, parallel);
+            report.expect(sameFlatTree(flattenTree(one.root), flattenTree(many.root)),
+                          string(t.info->file) + ": " + metric + (histogram ? " histogram" : "") + " tree differs between 1 and "
+                          + to_string(threads) + " threads");
+        }
+    }
+}
+
+//every forest tree only depends on its own seed, so the forest must be the same whichever thread built which tree
+void checkThreadedForest(const TestData& t, int threads, uint64_t seed, TestReport& report) {
+    ForestOptions serial;
+    serial.numTrees = 8;
+    serial.seed = seed;
+    ForestOptions parallel = serial;
+    parallel.threads = threads;
+    Forest one = trainForest(t.data, t.trainRows, t.featureIndices, t.labelIndex, "gini", t.info->attributeNames, serial);
+    Forest many = trainForest(t.data, t.trainRows, t.featureIndices, t.labelIndex, "gini", t.info->attributeNames, parallel);
+    bool same = one.flat.size() == many.flat.size();
+    for(size_t i = 0; same && i < one.flat.size(); i++)
+        same = sameFlatTree(one.flat[i], many.flat[i]);
+    report.expect(same, string(t.info->file) + ": forest differs between 1 and " + to_string(threads) + " threads");
+}
+
+//with exact bins a streamed tree must equal the in-memory histogram tree on the same training rows; the budget only
+//fits a few node histograms, so a level takes several passes; datasets with a numeric column that has more distinct
+//values than the schema pass keeps exactly are skipped, their bins come from a sample and may differ
+void checkStreamedTree(const TestData& t, uint64_t seed, TestReport& report) {
+    for(const Column& column : t.data.columns) {
+        if(column.numeric && unordered_set<float>(column.numbers.begin(), column.numbers.end()).size() > SKETCH_EXACT_VALUES)
+            return;
+    }
+    StreamOptions streamOptions;
+    streamOptions.memoryBudget = (4 << 16) + (256 << 10); //the smallest chunk buffer plus 256 KB of node histograms
+    streamOptions.seed = seed;
+    Dataset binned = t.data;
+    binNumericColumns(binned, streamOptions.maxBins);
+    vector<uint32_t> rows;
+    for(uint32_t r = 0; r < (uint32_t)binned.size(); r++)
+        if(isTrainRow(r, streamOptions))
+            rows.push_back(r);
+    TrainOptions histogram;
+    histogram.maxDepth = streamOptions.maxDepth;
+    histogram.histogram = true;
+    for(const char* metric : {"gini", "info", "gain"}) {
+        StreamModel streamed = trainStreaming(t.file, t.labelIndex, metric, t.info->attributeNames, streamOptions);
+        DecisionTree tree = buildTree(binned, rows, t.featureIndices, t.labelIndex, metric, t.info->attributeNames, histogram);
+        report.expect(sameFlatTree(streamed.flat, flattenTree(tree.root)),
+                      string(t.info->file) + ": streamed " + metric + " tree differs from the histogram tree");
+    }
+}
+
+//a model file whose split thresholds do not match their kind (NaN for categorical nodes, finite for numeric ones)
+//must be refused even with a valid checksum, the AVX2 and scalar kernels would walk it differently
+void checkCorruptModels(const TestData& t, TestReport& report) {
+    DecisionTree tree = buildTree(t.data, t.trainRows, t.featureIndices, t.labelIndex, "gini", t.info->attributeNames);
+    FlatTree flat = flattenTree(tree.root);
+    const string modelFile = makeTempFile("test_corrupt.dtm");
+    if(modelFile.empty() || !saveModel(modelFile, flat, t.data, t.info->attributeNames, t.labelIndex)) {
+        report.expect(false, "could not write a temporary model file");
+        if(!modelFile.empty())
+            remove(modelFile.c_str());
+        return;
+    }
+    string bytes;
+    {
+        ifstream in(modelFile, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    for(int kind = 0; kind < 3; kind++) { //a categorical split, a numeric split and a leaf
+        size_t i = 0;
+        while(i < flat.numNodes && (kind == 2 ? flat.nodes[i].feature >= 0
+                                    : flat.nodes[i].feature < 0 || (int)flat.nodes[i].numeric != kind))
+            i++;
+        if(i == flat.numNodes)
+            continue; //the tree has no node of this kind
+        string corrupt = bytes;
+        FlatNode node = flat.nodes[i];
+        node.threshold = kind == 1 ? numeric_limits<float>::quiet_NaN() : 0.5f;
+        memcpy(&corrupt[sizeof(ModelHeader) + i * sizeof(FlatNode)], &node, sizeof(FlatNode));
+        ModelHeader header;
+        memcpy(&header, corrupt.data(), sizeof(header));
+        header.checksum = fnv1a(corrupt.data() + sizeof(header), header.payloadSize); //only the layout check can catch it
+        memcpy(&corrupt[0], &header, sizeof(header));
+        ofstream(modelFile, ios::binary).write(corrupt.data(), corrupt.size());
+        Model model;
+        string error;
+        const char* kinds[] = {"categorical split", "numeric split", "leaf"};
+        report.expect(!loadModel(modelFile, model, error), string(t.info->file) + ": a model with a wrong threshold on a "
+                                                           + kinds[kind] + " was loaded");
+    }
+    remove(modelFile.c_str());
+}
+
+int runTests(const TestOptions& options) {
+    TestReport report;
+    KernelCheck kernels = checkCriterionKernels(options.seed);
+    cout << "criterion kernels: " << kernels.tables << " tables, max error entropy " << kernels.entropyError << " gini "
+         << kernels.giniError << " (tolerance " << CRITERION_TOLERANCE << ")\n";
+    report.expect(kernels.entropyError <= CRITERION_TOLERANCE, "entropy kernel is outside its tolerance");
+    report.expect(kernels.giniError <= CRITERION_TOLERANCE, "gini kernel is outside its tolerance");
+    report.expect(kernels.sameBits, "AVX2 and scalar criterion sums differ");
+
+    const vector<DatasetInfo>& datasets = knownDatasets();
+    vector<int> chosen = options.datasets;
+    if(chosen.empty())
+        for(int d = 1; d <= (int)datasets.size(); d++)
+            chosen.push_back(d);
+    for(int d : chosen) {
+        if(d < 1 || d > (int)datasets.size()) {
+            cerr << "No dataset number " << d << "\n";
+            return 1;
+        }
+        TestData t;
+        t.info = &datasets[d - 1];
+        t.labelIndex = findLabel(t.info->attributeNames, t.info->labelName);
+        size_t numRows = max<size_t>(200, (size_t)(t.info->rows * options.scale + 0.5)); //enough rows for a tree with some depth
+        t.file = makeTempFile("test_" + string(t.info->file));
+        if(t.file.empty() || !writeSyntheticData(*t.info, t.file, numRows, mixSeed(options.seed, d))) {
+            report.expect(false, string(t.info->file) + ": could not write the synthetic data");
+            if(!t.file.empty())
+                remove(t.file.c_str());
+            continue;
+        }
+        t.data = loadDataFile(t.file, ',', t.labelIndex, 1);
+        stratifiedSplit(t.data, t.labelIndex, t.trainRows, t.testRows, 0.7, (uint32_t)options.seed);
+        for(int i = 0; i < (int)t.data.columns.size(); i++)
+            if(i != t.labelIndex)
+                t.featureIndices.push_back(i);
+
+        int checks = report.checks, failed = report.failed;
+        checkStratifiedSplits(t, (uint32_t)options.seed, report);
+        checkBatchPredictions(t, report);
+        checkThreadedTrees(t, options.threads, report);
+        checkThreadedForest(t, options.threads, options.seed, report);
+        checkStreamedTree(t, options.seed, report);
+        checkPrunedModels(t, (uint32_t)options.seed, report);
+        checkCorruptModels(t, report);
+        remove(t.file.c_str());
+        cout << left << setw(26) << t.info->file << right << report.checks - checks << " checks, "
+             << report.failed - failed << " failed\n";
+    }
+
+    cout << report.checks << " checks, " << report.failed << " failed\n";
+    return report.failed > 0 ? 1 : 0;
+}
+
+//Command line
+//every subcommand reads "--name value" flags, plus a few switches that take no value
+bool parseFlags(int argc, char** argv, int first, const vector<string>& switches, map<string, string>& flags) {
+    for(int i = first; i < argc; i++) {
+        string flag = argv[i];
+        if(flag.compare(0, 2, "--") != 0) {
+            cerr << "Unexpected argument " << flag << "\n";
+            return false;
+        }
+        if(find(switches.begin(), switches.end(), flag) != switches.end()) {
+            flags[flag] = "1";
+            continue;
+        }
+        if(i + 1 >= argc) {
+            cerr << "Missing value for " << flag << "\n";
+            return false;
+        }
+        flags[flag] = argv[++i];
+    }
+    return true;
+}
+
+bool unknownFlags(const map<string, string>& flags, const vector<string>& known) { //typos must not silently change a run
+    for(const auto& flag : flags) {
+        if(find(known.begin(), known.end(), flag.first) == known.end()) {
+            cerr << "Unknown option " << flag.first << "\n";
+            return true;
+        }
+    }
+    return false;
+}
+
+string flagOr(const map<string, string>& flags, const string& name, const string& fallback) {
+    auto it = flags.find(name);
+    return it == flags.end() ? fallback : it->second;
+}
+
+//schema file: one column per line in file order, "name" or "name type" with type numeric, categorical or label
+//(the label is categorical), blank lines and lines starting with # are skipped
+bool readSchemaFile(const string& filename, vector<string>& names, vector<ColumnType>& types, string& labelName, string& error) {
+    ifstream file(filename);
+    if(!file) {
+        error = "Error opening schema file: " + filename;
+        return false;
+    }
+    names.clear();
+    types.clear();
+    string line;
+    for(int lineNumber = 1; getline(file, line); lineNumber++) {
+        istringstream fields(line);
+        string name, type, extra;
+        if(!(fields >> name) || name[0] == '#')
+            continue;
+        fields >> type;
+        if(fields >> extra) {
+            error = filename + ":" + to_string(lineNumber) + ": expected a name and an optional type";
+            return false;
+        }
+        if(type.empty() || type == "auto") {
+            types.push_back(AUTO_COLUMN);
+        } else if(type == "numeric") {
+            types.push_back(NUMERIC_COLUMN);
+        } else if(type == "categorical") {
+            types.push_back(CATEGORICAL_COLUMN);
+        } else if(type == "label") {
+            types.push_back(CATEGORICAL_COLUMN);
+            labelName = name;
+        } else {
+            error = filename + ":" + to_string(lineNumber) + ": unknown type " + type;
+            return false;
+        }
+        names.push_back(name);
+    }
+    if(names.empty()) {
+        error = filename + " has no columns";
+        return false;
+    }
+    return true;
+}
+
+char delimiterFlag(const map<string, string>& flags) {
+    string delimiter = flagOr(flags, "--delimiter", ",");
+    if(delimiter == "\\t" || delimiter == "tab")
+        return '\t';
+    return delimiter.empty() ? ',' : delimiter[0];
+}
+
+int threadsFlag(const map<string, string>& flags) { //0 means every core, like the interactive prompt
+    int threads = atoi(flagOr(flags, "--threads", "1").c_str());
+    return threads > 0 ? threads : max(1, (int)thread::hardware_concurrency());
+}
+
+void printUsage() {
+    cout << "Usage:\n"
+         << "  decisiontree                      interactive menu over the bundled datasets\n"
+         << "  decisiontree train --data FILE [--header] [--schema FILE] [--dataset N] [--label NAME]\n"
+         << "                     [--metric gini|info|gain] [--max-depth 8] [--threads 1] [--seed 42]\n"
+         << "                     [--holdout 0.3] [--histogram] [--delimiter ,] [--model model.dtm] [--profile trace.json]\n"
+         << "                     [--prune rep|ccp] [--validation 0.25] [--folds K]\n"
+         << "  decisiontree predict --model FILE --data FILE [--header] [--schema FILE] [--dataset N] [--label NAME]\n"
+         << "                       [--threads 1] [--delimiter ,] [--out predictions.txt]\n"
+         << "  decisiontree serve --model FILE [--socket PATH] [--threads 1] [--batch 256] [--delimiter ,]\n"
+         << "  decisiontree bench [--scale 1] [--repeats 3] [--threads 1] [--seed 1] [--datasets 1,2]\n"
+         << "                     [--metrics gini,info,gain] [--out bench.json]\n"
+         << "  decisiontree test [--scale 0.25] [--threads 4] [--seed 1] [--datasets 1,2]\n";
+}
+
+//input file, column names, declared types and label of a train or predict command line:
+//names come from --schema, --header or --dataset, else the columns are numbered c1, c2, ...,
+//the label is --label, the schema's or dataset's label, else the last column
+//both commands resolve them the same way, so predict can check a file against the schema a model was trained on
+bool resolveColumns(map<string, string>& flags, const string& command, string& inputFile, vector<string>& attributeNames,
+                    vector<ColumnType>& types, int& labelIndex) {
+    inputFile = flagOr(flags, "--data", "");
+    string labelName;
+    if(flags.count("--dataset")) { //one of the bundled datasets, the same table as the interactive menu
+        int number = atoi(flags["--dataset"].c_str());
+        const vector<DatasetInfo>& datasets = knownDatasets();
+        if(number < 1 || number > (int)datasets.size()) {
+            cerr << "No dataset number " << flags["--dataset"] << "\n";
+            return false;
+        }
+        attributeNames = datasets[number - 1].attributeNames;
+        labelName = datasets[number - 1].labelName;
+        if(inputFile.empty())
+            inputFile = datasets[number - 1].file;
+    }
+    if(inputFile.empty()) {
+        cerr << command << " needs --data FILE or --dataset N\n";
+        return false;
+    }
+    char delimiter = delimiterFlag(flags);
+    if(flags.count("--schema")) {
+        string error;
+        if(!readSchemaFile(flags["--schema"], attributeNames, types, labelName, error)) {
+            cerr << error << "\n";
+            return false;
+        }
+    } else if(flags.count("--header")) {
+        attributeNames = readHeader(inputFile, delimiter);
+    }
+    if(attributeNames.empty()) { //no names anywhere: number the columns of the first line
+        size_t numColumns = readHeader(inputFile, delimiter).size();
+        for(size_t c = 0; c < numColumns; c++)
+            attributeNames.push_back("c" + to_string(c + 1));
+    }
+    labelName = flagOr(flags, "--label", labelName);
+    labelIndex = labelName.empty() ? (int)attributeNames.size() - 1 : findLabel(attributeNames, labelName); //default: last column
+    if(labelIndex < 0) {
+        cerr << "Label '" << labelName << "' not found in the column names\n";
+        return false;
+    }
+    if(labelIndex < (int)types.size())
+        types[labelIndex] = CATEGORICAL_COLUMN;
+    return true;
+}
+
+bool finishProfile(map<string, string>& flags) { //summary and trace of a train run with --profile, false if the trace could not be written
+    if(!profiler.enabled())
+        return true;
+    profiler.printSummary(cout);
+    if(!profiler.writeTrace(flags["--profile"])) {
+        cerr << "Error writing " << flags["--profile"] << "\n";
+        return false;
+    }
+    return true;
+}
+
+//trains one tree on a file and saves it; column names come from --schema, the header row, a bundled dataset or are numbered
+int trainCommand(int argc, char** argv) {
+    map<string, string> flags;
+    if(!parseFlags(argc, argv, 2, {"--header", "--histogram"}, flags)
+       || unknownFlags(flags, {"--data", "--header", "--schema", "--dataset", "--label", "--metric", "--max-depth", "--threads",
+                               "--seed", "--holdout", "--histogram", "--delimiter", "--model", "--profile", "--prune",
+                               "--validation", "--folds"}))
+        return 1;
+
+    string inputFile;
+    vector<string> attributeNames;
+    vector<ColumnType> types;
+    int labelIndex;
+    if(!resolveColumns(flags, "train", inputFile, attributeNames, types, labelIndex))
+        return 1;
+    char delimiter = delimiterFlag(flags);
+    bool hasHeader = flags.count("--header") > 0;
+
+    string metric = flagOr(flags, "--metric", "gini");
+    if(metric != "gini" && metric != "info" && metric != "gain") {
+        cerr << "Invalid metric " << metric << " (use gini, info or gain)\n";
+        return 1;
+    }
+    double holdout = atof(flagOr(flags, "--holdout", "0.3").c_str());
+    if(holdout < 0 || holdout >= 1) {
+        cerr << "--holdout must be in [0, 1)\n";
+        return 1;
+    }
+    string pruneFlag = flagOr(flags, "--prune", "");
+    int pruneMethod = pruneFlag == "rep" ? 1 : pruneFlag == "ccp" ? 2 : 0;
+    if(!pruneFlag.empty() && pruneMethod == 0) {
+        cerr << "Invalid pruning method " << pruneFlag << " (use rep or ccp)\n";
+        return 1;
+    }
+    double validation = atof(flagOr(flags, "--validation", "0.25").c_str());
+    if(validation <= 0 || validation >= 1) {
+        cerr << "--validation must be in (0, 1)\n";
+        return 1;
+    }
+    int folds = atoi(flagOr(flags, "--folds", "0").c_str());
+    if(flags.count("--folds") && folds < 2) {
+        cerr << "--folds must be at least 2\n";
+        return 1;
+    }
+    TrainOptions options;
+    options.maxDepth = atoi(flagOr(flags, "--max-depth", "8").c_str());
+    options.threads = threadsFlag(flags);
+    options.histogram = flags.count("--histogram") > 0;
+    uint32_t seed = (uint32_t)strtoul(flagOr(flags, "--seed", to_string(DEFAULT_SEED)).c_str(), nullptr, 10);
+    options.seed = seed;
+    if(flags.count("--profile"))
+        profiler.enable();
+
+    auto loadStart = chrono::steady_clock::now();
+    Dataset data = loadDataFile(inputFile, delimiter, labelIndex, options.threads, hasHeader, types);
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+    if(data.empty()) {
+        cerr << "No data loaded!\n";
+        return 1;
+    }
+    if(attributeNames.size() != data.columns.size()) {
+        cerr << inputFile << " has " << data.columns.size() << " columns but " << attributeNames.size() << " names were given\n";
+        return 1;
+    }
+    if(options.histogram)
+        binNumericColumns(data);
+
+    vector<int> featureIndices;
+    for(int i = 0; i < (int)data.columns.size(); i++)
+        if(i != labelIndex)
+            featureIndices.push_back(i);
+    if(folds > 0) { //cross validation only reports, no model is saved
+        if(folds > (int)data.size()) {
+            cerr << "More folds than samples\n";
+            return 1;
+        }
+        reportCrossValidation(data, featureIndices, labelIndex, metric, attributeNames, options, folds, options.threads, seed);
+        return finishProfile(flags) ? 0 : 1;
+    }
+
+    vector<uint32_t> trainRows, testRows;
+    stratifiedSplit(data, labelIndex, trainRows, testRows, 1.0 - holdout, seed); //every class keeps its share on both sides
+    vector<uint32_t> validationRows; //carved out of the training rows, the holdout stays untouched for the final accuracy
+    if(pruneMethod > 0)
+        holdOutRows(trainRows, validation, seed, validationRows);
+
+    auto trainStart = chrono::steady_clock::now();
+    DecisionTree tree = buildTree(data, trainRows, featureIndices, labelIndex, metric, attributeNames, options);
+    double trainSeconds = chrono::duration<double>(chrono::steady_clock::now() - trainStart).count();
+    if(pruneMethod > 0)
+        pruneAndReport(tree, data, labelIndex, validationRows, pruneMethod);
+    FlatTree model = flattenTree(tree.root);
+
+    cout << "rows: " << data.size() << " (" << trainRows.size() << " train, " << validationRows.size() << " validation, "
+         << testRows.size() << " holdout)\n";
+    cout << "label: " << attributeNames[labelIndex] << " (column " << labelIndex << ", " << data.columns[labelIndex].cardinality() << " classes)\n";
+    cout << "load seconds: " << loadSeconds << "\n";
+    cout << "train seconds: " << trainSeconds << "\n";
+    cout << "nodes: " << model.size() << "\n";
+    if(!testRows.empty())
+        cout << "holdout accuracy: " << calculateAccuracy(model, data, testRows, labelIndex) << "%\n";
+
+    string modelFile = flagOr(flags, "--model", "model.dtm");
+    if(!saveModel(modelFile, model, data, attributeNames, labelIndex)) {
+        cerr << "Error writing " << modelFile << "\n";
+        return 1;
+    }
+    cout << "model: " << modelFile << "\n";
+    return finishProfile(flags) ? 0 : 1;
+}
+
+//rewrites the categorical codes of data (loaded with the model's column types) into the model's dictionaries,
+//values the model never saw become UNKNOWN_CODE and take the fallback label of the node they reach
+//the label column is copied to inputLabels first, so labels the model never saw (such as "?") can still be printed as read
+bool encodeForModel(Dataset& data, const Model& model, Column& inputLabels, string& error) {
+    if(data.columns.size() != model.numColumns) {
+        error = "the file has " + to_string(data.columns.size()) + " columns but the model expects " + to_string(model.numColumns);
+        return false;
+    }
+    inputLabels = data.columns[model.labelIndex];
+    for(size_t c = 0; c < model.numColumns; c++) {
+        Column& column = data.columns[c];
+        if(model.numeric(c))
+            continue;
+        unordered_map<string_view, uint32_t> lookup;
+        for(uint32_t code = 0; code < model.cardinality(c); code++)
+            lookup.emplace(model.value(c, code), code);
+        vector<uint32_t> remap(column.cardinality());
+        for(uint32_t code = 0; code < remap.size(); code++) {
+            auto found = lookup.find(column.values[code]);
+            remap[code] = found == lookup.end() ? UNKNOWN_CODE : found->second;
+        }
+        for(uint32_t& code : column.codes)
+            code = remap[code];
+        column.values.resize(model.cardinality(c)); //decode now reads the model's strings
+        for(uint32_t code = 0; code < model.cardinality(c); code++)
+            column.values[code] = string(model.value(c, code));
+    }
+    return true;
+}
+
+//checks that a data file has the columns of the model: the same count, label and names (the types come from the model),
+//otherwise prints the first difference
+bool sameColumns(const Model& model, const Dataset& data, const vector<string>& attributeNames, int labelIndex,
+                 const string& inputFile) {
+    if(data.columns.size() != model.numColumns) {
+        cerr << inputFile << " has " << data.columns.size() << " columns but the model has " << model.numColumns << "\n";
+        return false;
+    }
+    if(labelIndex != model.labelIndex) {
+        cerr << "The label is column " << labelIndex + 1 << " of " << inputFile << " but column " << model.labelIndex + 1
+             << " (" << model.columnName(model.labelIndex) << ") of the model, use --label\n";
+        return false;
+    }
+    for(size_t c = 0; c < model.numColumns; c++) {
+        if(attributeNames[c] != model.columnName(c)) {
+            cerr << "Column " << c + 1 << " of " << inputFile << " is " << attributeNames[c] << " but the model calls it "
+                 << model.columnName(c) << " (names come from --header, --schema or --dataset)\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+//scores a file with a saved model; the file has the training columns in the same order (the label may be "?")
+int predictCommand(int argc, char** argv) {
+    map<string, string> flags;
+    if(!parseFlags(argc, argv, 2, {"--header"}, flags)
+       || unknownFlags(flags, {"--model", "--data", "--header", "--schema", "--dataset", "--label", "--delimiter", "--threads",
+                               "--out"}))
+        return 1;
+    if(!flags.count("--model")) {
+        cerr << "predict needs --model FILE\n";
+        return 1;
+    }
+    string inputFile;
+    vector<string> attributeNames;
+    vector<ColumnType> types;
+    int labelIndex;
+    if(!resolveColumns(flags, "predict", inputFile, attributeNames, types, labelIndex))
+        return 1;
+
+    auto start = chrono::steady_clock::now();
+    Model model;
+    string error;
+    if(!loadModel(flags["--model"], model, error)) {
+        cerr << error << "\n";
+        return 1;
+    }
+    types.assign(model.numColumns, CATEGORICAL_COLUMN); //the model knows the types, a small file could look otherwise
+    for(size_t c = 0; c < model.numColumns; c++) {
+        if(model.numeric(c))
+            types[c] = NUMERIC_COLUMN;
+    }
+    Dataset data = loadDataFile(inputFile, delimiterFlag(flags), labelIndex, threadsFlag(flags), flags.count("--header") > 0, types);
+    if(attributeNames.size() != data.columns.size()) {
+        cerr << inputFile << " has " << data.columns.size() << " columns but " << attributeNames.size() << " names were given\n";
+        return 1;
+    }
+    if(!sameColumns(model, data, attributeNames, labelIndex, inputFile))
+        return 1;
+    Column inputLabels;
+    if(!encodeForModel(data, model, inputLabels, error)) {
+        cerr << inputFile << ": " << error << "\n";
+        return 1;
+    }
+    vector<uint32_t> rows(data.size());
+    for(uint32_t i = 0; i < (uint32_t)rows.size(); i++)
+        rows[i] = i;
+    vector<uint32_t> predictions = predictRows(model.tree, data, rows);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    string outName = flagOr(flags, "--out", "predictions.txt");
+    if(!writePredictions(outName, predictions, inputLabels, data, model.labelIndex)) { //predicted labels come from the model's dictionary
+        cerr << "Error writing " << outName << "\n";
+        return 1;
+    }
+    Evaluation eval = evaluate(predictions, data, rows, model.labelIndex); //only rows whose label the model knows count
+    cout << "rows: " << data.size() << "\n";
+    cout << "seconds: " << seconds << "\n";
+    if(eval.rows > 0)
+        cout << "accuracy: " << eval.accuracy() << "% (" << eval.rows << " rows with a known label)\n";
+    cout << "predictions: " << outName << "\n";
+    return 0;
+}
+
+//reads the flags after "bench", anything unknown is an error so typos do not silently change what is measured
+int benchCommand(int argc, char** argv) {
+    map<string, string> flags;
+    if(!parseFlags(argc, argv, 2, {}, flags)
+       || unknownFlags(flags, {"--scale", "--repeats", "--threads", "--seed", "--out", "--datasets", "--metrics"}))
+        return 1;
+    BenchOptions options;
+    options.scale = atof(flagOr(flags, "--scale", "1").c_str());
+    options.repeats = max(1, atoi(flagOr(flags, "--repeats", "3").c_str()));
+    options.threads = threadsFlag(flags);
+    options.seed = strtoull(flagOr(flags, "--seed", "1").c_str(), nullptr, 10);
+    options.output = flagOr(flags, "--out", options.output);
+    string item;
+    istringstream datasetList(flagOr(flags, "--datasets", "")); //comma separated menu numbers
+    while(getline(datasetList, item, ','))
+        options.datasets.push_back(atoi(item.c_str()));
+    if(flags.count("--metrics")) {
+        options.metrics.clear();
+        istringstream metricList(flags["--metrics"]);
+        while(getline(metricList, item, ',')) {
+            if(item != "gini" && item != "info" && item != "gain") {
+                cerr << "Unknown metric " << item << "\n";
+                return 1;
+            }
+            options.metrics.push_back(item);
+        }
+    }
+    if(options.scale <= 0) {
+        cerr << "--scale must be positive\n";
+        return 1;
+    }
+    return runBenchmark(options);
+}
+
+int testCommand(int argc, char** argv) {
+    map<string, string> flags;
+    if(!parseFlags(argc, argv, 2, {}, flags) || unknownFlags(flags, {"--scale", "--threads", "--seed", "--datasets"}))
+        return 1;
+    TestOptions options;
+    options.scale = atof(flagOr(flags, "--scale", "0.25").c_str());
+    options.threads = max(2, atoi(flagOr(flags, "--threads", "4").c_str()));
+    options.seed = strtoull(flagOr(flags, "--seed", "1").c_str(), nullptr, 10);
+    string item;
+    istringstream datasetList(flagOr(flags, "--datasets", "")); //comma separated menu numbers
+    while(getline(datasetList, item, ','))
+        options.datasets.push_back(atoi(item.c_str()));
+    if(options.scale <= 0) {
+        cerr << "--scale must be positive\n";
+        return 1;
+    }
+    return runTests(options);
+}
+
+//Serving
+#ifdef HAVE_UNIX_SOCKETS
+//a long running scorer: every input line is a row in the training column order (the label may be left out)
+//and gets one output line with the predicted label, in order; lines starting with '!' are commands
+//connections only split lines, worker threads take whatever rows have queued up (up to a batch, from any client)
+//and encode and predict them together, so a busy server fills its batches by itself
+struct ServedModel { //a loaded model plus lookups to encode request text with its dictionaries
+    Model model;
+    string file;
+    uint64_t version; //set by ModelSlot::publish: 1 for the model the server started with, one more per reload
+    vector<unordered_map<string_view, uint32_t>> lookup; //categorical column -> value -> code, the views point into the mapped file
+};
+
+ServedModel* loadServedModel(const string& file, uint64_t expectedSchema, string& error) {
+    unique_ptr<ServedModel> served(new ServedModel());
+    if(!loadModel(file, served->model, error, expectedSchema))
+        return nullptr;
+    served->file = file;
+    served->version = 0; //not published yet
+    served->lookup.resize(served->model.numColumns);
+    for(size_t c = 0; c < served->model.numColumns; c++) {
+        if(served->model.numeric(c))
+            continue;
+        for(uint32_t code = 0; code < served->model.cardinality(c); code++)
+            served->lookup[c].emplace(served->model.value(c, code), code);
+    }
+    return served.release();
+}
+
+//read-copy-update slot for the served model: a worker reads the pointer with no lock and no reference count,
+//it only posts the epoch it entered in; a reload swaps the pointer atomically and frees the old model after a grace period,
+//once no worker is still inside a batch it started before the swap (only the reloading thread ever waits)
+class ModelSlot {
+public:
+    explicit ModelSlot(int numReaders) : current(nullptr), epoch(1), readers(numReaders), published(0) {
+        for(auto& r : readers)
+            r = 0; //0 means not reading
+    }
+
+    ~ModelSlot() { delete current.load(); }
+
+    const ServedModel* enter(int reader) { //start of a read: the model stays valid until exit
+        readers[reader].store(epoch.load());
+        return current.load();
+    }
+
+    void exit(int reader) { readers[reader].store(0); }
+
+    //makes model the current one and frees the previous one once it is unused, returns the version it gave model
+    //versions are handed out under the writers lock, so they follow the order models were published in;
+    //model may be freed by a later publish as soon as this returns, so callers must not touch it afterwards
+    uint64_t publish(ServedModel* model) {
+        lock_guard<mutex> lock(writers);
+        uint64_t version = model->version = ++published;
+        const ServedModel* old = current.exchange(model);
+        uint64_t swapped = epoch.fetch_add(1) + 1; //readers that may hold old entered in an earlier epoch
+        for(auto& r : readers) {
+            while(true) {
+                uint64_t entered = r.load();
+                if(entered == 0 || entered >= swapped)
+                    break;
+                this_thread::yield();
+            }
+        }
+        delete old;
+        return version;
+    }
+
+    template<typename F>
+    auto withCurrent(F f) { //looks at the current model from outside the workers (commands and reloads)
+        lock_guard<mutex> lock(writers); //no publish can free it meanwhile
+        return f(*current.load());
+    }
+
+private:
+    atomic<const ServedModel*> current;
+    atomic<uint64_t> epoch;
+    vector<atomic<uint64_t>> readers; //epoch every worker entered in
+    mutex writers;
+    uint64_t published; //models published so far, guarded by writers
+};
+
+struct PendingRows { //rows of one connection that are waiting for their answers
+    vector<string> answers;
+    atomic<size_t> remaining;
+    mutex lock;
+    condition_variable done;
+
+    PendingRows() : remaining(0) {}
+};
+
+struct ServeRequest {
+    string_view line; //points into the connection's buffer, which waits for the answer
+    size_t slot;      //index in owner->answers
+    PendingRows* owner;
+    chrono::steady_clock::time_point arrived; //when the line was parsed off the input
+};
+
+//latency counts in log spaced buckets, so memory stays fixed however long the server runs:
+//16 buckets per power of two of nanoseconds, which puts a reported percentile within about 3% of the true one
+//every worker owns one and only ever adds to it, readers sum them up
+struct LatencyHistogram {
+    static const int SUB_BITS = 4;
+    static const size_t NUM_BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+    atomic<uint64_t> counts[NUM_BUCKETS];
+
+    LatencyHistogram() {
+        for(auto& count : counts)
+            count = 0;
+    }
+
+    static size_t bucketOf(uint64_t ns) {
+        if(ns < (1u << SUB_BITS)) //small values get a bucket each
+            return ns;
+        int exponent = 63 - __builtin_clzll(ns);
+        uint64_t sub = (ns >> (exponent - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+        return ((size_t)(exponent - SUB_BITS + 1) << SUB_BITS) + sub;
+    }
+
+    static double lowerBound(size_t bucket) { //smallest value of a bucket in nanoseconds
+        if(bucket < (1u << SUB_BITS))
+            return (double)bucket;
+        int exponent = (int)(bucket >> SUB_BITS) + SUB_BITS - 1;
+        uint64_t sub = bucket & ((1u << SUB_BITS) - 1);
+        return ldexp((double)((1u << SUB_BITS) + sub), exponent - SUB_BITS);
+    }
+
+    void record(uint64_t ns) { counts[bucketOf(ns)].fetch_add(1, memory_order_relaxed); }
+};
+
+struct Server {
+    ModelSlot slot;
+    char delimiter;
+    size_t maxBatch;
+
+    mutex queueLock;
+    condition_variable queued;
+    deque<ServeRequest> queue;
+    bool closed; //no more requests, workers exit once the queue is empty
+    atomic<bool> stopping; //a client sent !shutdown
+
+    vector<unique_ptr<LatencyHistogram>> latencies; //per worker: time from a row arriving to its answer
+    atomic<size_t> batches;
+    chrono::steady_clock::time_point started;
+
+    Server(int numWorkers, char delimiter, size_t maxBatch)
+        : slot(numWorkers), delimiter(delimiter), maxBatch(maxBatch), closed(false), stopping(false), batches(0),
+          started(chrono::steady_clock::now()) {
+        for(int i = 0; i < numWorkers; i++)
+            latencies.emplace_back(new LatencyHistogram());
+    }
+};
+
+//fills one row of cells from a request line, false with a message if the line does not fit the model's columns
+bool encodeRequest(const ServedModel& served, string_view line, char delimiter, Cell* cells, string& error) {
+    const Model& model = served.model;
+    vector<string_view> fields; //a handful of views, small enough to stay cheap per row
+    size_t start = 0;
+    while(start < line.size()) { //split like parseLines: a trailing delimiter does not start another field
+        size_t stop = line.find(delimiter, start);
+        if(stop == string_view::npos)
+            stop = line.size();
+        fields.push_back(trimCell(line.substr(start, stop - start)));
+        start = stop + 1;
+    }
+    bool withLabel = fields.size() == model.numColumns;
+    if(!withLabel && fields.size() + 1 != model.numColumns) {
+        error = "expected " + to_string(model.numColumns - 1) + " or " + to_string(model.numColumns) + " fields, got " + to_string(fields.size());
+        return false;
+    }
+    size_t field = 0;
+    for(size_t c = 0; c < model.numColumns; c++) {
+        if((int)c == model.labelIndex) { //never read by the tree
+            cells[c].code = UNKNOWN_CODE;
+            field += withLabel;
+            continue;
+        }
+        string_view text = fields[field++];
+        if(model.numeric(c)) {
+            cells[c].number = numeric_limits<float>::quiet_NaN(); //missing values follow the "greater" branch as in training
+            if(!parseNumber(string(text), cells[c].number) && !isMissing(string(text))) {
+                error = "column " + string(model.columnName(c)) + " expects a number, got " + string(text);
+                return false;
+            }
+        } else {
+            auto found = served.lookup[c].find(text);
+            cells[c].code = found == served.lookup[c].end() ? UNKNOWN_CODE : found->second; //unseen values take the fallback label
+        }
+    }
+    return true;
+}
+
+//worker id: takes up to maxBatch queued rows at a time, predicts them in one batch against one model and answers them
+void serveWorker(Server& server, int id) {
+    vector<ServeRequest> batch;
+    vector<Cell> cells;
+    vector<size_t> encoded; //batch index of every row that made it into cells
+    vector<uint32_t> predictions;
+    LatencyHistogram& latencies = *server.latencies[id];
+    string error;
+    while(true) {
+        batch.clear();
+        {
+            unique_lock<mutex> lock(server.queueLock);
+            server.queued.wait(lock, [&server] { return !server.queue.empty() || server.closed; });
+            if(server.queue.empty())
+                return;
+            size_t take = min(server.maxBatch, server.queue.size());
+            batch.assign(server.queue.begin(), server.queue.begin() + take);
+            server.queue.erase(server.queue.begin(), server.queue.begin() + take);
+        }
+
+        const ServedModel* served = server.slot.enter(id);
+        size_t stride = served->model.numColumns;
+        cells.resize(batch.size() * stride);
+        encoded.clear();
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(encodeRequest(*served, batch[i].line, server.delimiter, cells.data() + encoded.size() * stride, error))
+                encoded.push_back(i);
+            else
+                batch[i].owner->answers[batch[i].slot] = "error: " + error;
+        }
+        predictions.resize(encoded.size());
+        if(!encoded.empty())
+            predictBatch(served->model.tree, cells.data(), encoded.size(), stride, predictions.data());
+        for(size_t k = 0; k < encoded.size(); k++) {
+            const ServeRequest& request = batch[encoded[k]];
+            request.owner->answers[request.slot] = string(served->model.decodeLabel(predictions[k]));
+        }
+        server.slot.exit(id);
+
+        auto now = chrono::steady_clock::now();
+        for(const ServeRequest& request : batch)
+            latencies.record((uint64_t)chrono::duration_cast<chrono::nanoseconds>(now - request.arrived).count());
+        server.batches++;
+        for(const ServeRequest& request : batch) { //the last answer of a connection's rows wakes it up
+            if(request.owner->remaining.fetch_sub(1) == 1) {
+                lock_guard<mutex> lock(request.owner->lock);
+                request.owner->done.notify_one();
+            }
+        }
+    }
+}
+
+bool writeAll(int fd, const string& text) { //false once the other side has gone away
+    size_t written = 0;
+    while(written < text.size()) {
+        ssize_t n = write(fd, text.data() + written, text.size() - written);
+        if(n <= 0)
+            return false;
+        written += (size_t)n;
+    }
+    return true;
+}
+
+//value below which fraction of the counted latencies fall, in microseconds (the middle of the bucket it lands in)
+double percentile(const vector<uint64_t>& counts, uint64_t total, double fraction) {
+    if(total == 0)
+        return 0;
+    uint64_t rank = min(total - 1, (uint64_t)(fraction * total));
+    uint64_t seen = 0;
+    for(size_t b = 0; b < counts.size(); b++) {
+        seen += counts[b];
+        if(seen > rank)
+            return (LatencyHistogram::lowerBound(b) + LatencyHistogram::lowerBound(b + 1)) / 2 / 1000;
+    }
+    return 0;
+}
+
+string serveStats(Server& server) { //one line: rows, batches, throughput and latency percentiles
+    vector<uint64_t> counts(LatencyHistogram::NUM_BUCKETS, 0);
+    uint64_t rows = 0;
+    for(const auto& histogram : server.latencies) {
+        for(size_t b = 0; b < counts.size(); b++) {
+            uint64_t count = histogram->counts[b].load(memory_order_relaxed);
+            counts[b] += count;
+            rows += count;
+        }
+    }
+    size_t batches = server.batches;
+    uint64_t reloads = server.slot.withCurrent([](const ServedModel& served) { return served.version - 1; });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - server.started).count();
+    ostringstream line;
+    line << fixed << setprecision(1) << "rows " << rows << " batches " << batches << " mean batch "
+         << (batches > 0 ? (double)rows / batches : 0.0) << " rows/s " << rows / max(seconds, 1e-9)
+         << " p50 " << percentile(counts, rows, 0.50) << "us p99 " << percentile(counts, rows, 0.99) << "us reloads " << reloads;
+    return line.str();
+}
+
+string serveCommandLine(Server& server, string_view command) { //answer to one '!' line
+    string_view name = command.substr(0, command.find(' '));
+    string argument = command.size() > name.size() ? string(trimCell(command.substr(name.size()))) : string();
+    if(name == "!stats")
+        return serveStats(server);
+    if(name == "!shutdown") {
+        server.stopping = true;
+        return "ok shutting down";
+    }
+    if(name == "!reload") { //the new model has to take the same rows, so it must have the same schema
+        string error;
+        auto current = server.slot.withCurrent([](const ServedModel& served) { return make_pair(served.file, served.model.schema); });
+        string file = argument.empty() ? current.first : argument;
+        ServedModel* fresh = loadServedModel(file, current.second, error);
+        if(fresh == nullptr)
+            return "error: " + error;
+        size_t nodes = fresh->model.tree.size(); //read before publishing, a concurrent reload may free fresh right after
+        uint64_t version = server.slot.publish(fresh);
+        return "ok model " + file + " version " + to_string(version) + " nodes " + to_string(nodes);
+    }
+    return "error: unknown command " + string(command) + " (use !stats, !reload [FILE] or !shutdown)";
+}
+
+//answers one client until it closes its side (or sends !shutdown); rows are answered in the order they came in
+void serveConnection(Server& server, int inFd, int outFd) {
+    string buffer, output;
+    vector<char> chunk(1 << 16);
+    PendingRows pending;
+    vector<ServeRequest> requests;
+    bool open = true;
+    while(open && !server.stopping) {
+        ssize_t n = read(inFd, chunk.data(), chunk.size());
+        if(n > 0)
+            buffer.append(chunk.data(), (size_t)n);
+        else
+            open = false; //answer what is left, a last line may lack its newline
+        size_t usable = open ? buffer.rfind('\n') : buffer.size();
+        if(usable == string::npos)
+            continue;
+        usable += open; //include the newline
+
+        auto flush = [&]() { //hand the collected rows to the workers and write their answers
+            if(requests.empty())
+                return;
+            pending.answers.assign(requests.size(), string());
+            pending.remaining = requests.size();
+            {
+                lock_guard<mutex> lock(server.queueLock);
+                server.queue.insert(server.queue.end(), requests.begin(), requests.end());
+            }
+            server.queued.notify_all();
+            unique_lock<mutex> lock(pending.lock);
+            pending.done.wait(lock, [&pending] { return pending.remaining == 0; });
+            for(const string& answer : pending.answers) {
+                output += answer;
+                output += '\n';
+            }
+            requests.clear();
+        };
+
+        string_view text(buffer.data(), usable);
+        size_t pos = 0;
+        while(pos < text.size()) {
+            size_t lineEnd = text.find('\n', pos);
+            if(lineEnd == string_view::npos)
+                lineEnd = text.size();
+            string_view line = trimCell(text.substr(pos, lineEnd - pos));
+            pos = lineEnd + 1;
+            if(line.empty())
+                continue;
+            if(line[0] == '!') { //commands run between the rows before and after them
+                flush();
+                output += serveCommandLine(server, line);
+                output += '\n';
+                continue;
+            }
+            requests.push_back({line, requests.size(), &pending, chrono::steady_clock::now()}); //its latency includes the wait for the batch
+        }
+        flush();
+        if(!writeAll(outFd, output))
+            open = false;
+        output.clear();
+        buffer.erase(0, usable);
+    }
+}
+
+//accepts clients on a unix socket, one thread per connection, until a client sends !shutdown
+bool serveSocket(Server& server, const string& path) {
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(listener < 0 || path.size() >= sizeof(address.sun_path)) {
+        cerr << "Cannot create socket " << path << "\n";
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+    unlink(path.c_str()); //a stale socket file from an earlier run
+    if(bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        cerr << "Cannot listen on " << path << ": " << strerror(errno) << "\n";
+        close(listener);
+        return false;
+    }
+    cerr << "listening on " << path << "\n";
+
+    unordered_map<uint64_t, thread> connections; //by connection number, until the thread is joined
+    uint64_t accepted = 0;
+    mutex openLock;
+    unordered_set<int> openClients; //shut down on exit so idle clients do not keep their threads blocked in read
+    vector<uint64_t> finished;      //connections whose thread is done and can be joined, guarded by openLock
+    while(!server.stopping) {
+        vector<uint64_t> done; //joined here so a long running server does not keep a thread per past client
+        {
+            lock_guard<mutex> lock(openLock);
+            done.swap(finished);
+        }
+        for(uint64_t id : done) {
+            connections[id].join();
+            connections.erase(id);
+        }
+        pollfd waiting = {listener, POLLIN, 0};
+        if(poll(&waiting, 1, 100) <= 0) //wakes up now and then to notice a shutdown
+            continue;
+        int client = accept(listener, nullptr, nullptr);
+        if(client < 0)
+            continue;
+        {
+            lock_guard<mutex> lock(openLock);
+            openClients.insert(client);
+        }
+        uint64_t id = accepted++;
+        connections.emplace(id, thread([&server, &openLock, &openClients, &finished, client, id] {
+            serveConnection(server, client, client);
+            lock_guard<mutex> lock(openLock);
+            openClients.erase(client);
+            close(client);
+            finished.push_back(id);
+        }));
+    }
+    {
+        lock_guard<mutex> lock(openLock);
+        for(int client : openClients)
+            shutdown(client, SHUT_RDWR);
+    }
+    for(auto& connection : connections)
+        connection.second.join();
+    close(listener);
+    unlink(path.c_str());
+    return true;
+}
+
+//serves a model file over stdin and stdout, or a unix socket, until the input ends or a client sends !shutdown
+int serveCommand(int argc, char** argv) {
+    map<string, string> flags;
+    if(!parseFlags(argc, argv, 2, {}, flags)
+       || unknownFlags(flags, {"--model", "--socket", "--threads", "--batch", "--delimiter"}))
+        return 1;
+    if(!flags.count("--model")) {
+        cerr << "serve needs --model FILE\n";
+        return 1;
+    }
+    string error;
+    ServedModel* first = loadServedModel(flags["--model"], 0, error);
+    if(first == nullptr) {
+        cerr << error << "\n";
+        return 1;
+    }
+    int threads = threadsFlag(flags);
+    size_t maxBatch = (size_t)max(1, atoi(flagOr(flags, "--batch", "256").c_str()));
+    Server server(threads, delimiterFlag(flags), maxBatch);
+    server.slot.publish(first);
+    signal(SIGPIPE, SIG_IGN); //a client that hangs up early is a failed write, not the end of the server
+
+    vector<thread> workers;
+    for(int i = 0; i < threads; i++)
+        workers.emplace_back(serveWorker, ref(server), i);
+    bool ok = true;
+    if(flags.count("--socket"))
+        ok = serveSocket(server, flags["--socket"]);
+    else
+        serveConnection(server, STDIN_FILENO, STDOUT_FILENO);
+    {
+        lock_guard<mutex> lock(server.queueLock);
+        server.closed = true;
+    }
+    server.queued.notify_all();
+    for(auto& worker : workers)
+        worker.join();
+    cerr << "served " << serveStats(server) << "\n"; //stdout carries the answers
+    return ok ? 0 : 1;
+}
+#endif
+
+void reportProfile() { //summary table on stdout and a chrome trace file, only if profiling was switched on
+    if(!profiler.enabled())
+        return;
+    profiler.printSummary(cout);
+    if(profiler.writeTrace("trace.json"))
+        cout << "Trace written to trace.json (open it in chrome://tracing or ui.perfetto.dev)\n";
+    else
+        cerr << "Error writing trace.json\n";
+}
+
+int main(int argc, char** argv) {
+    if(argc > 1) { //scriptable subcommands, nothing is read from cin
+        string command = argv[1];
+        if(command == "train")
+            return trainCommand(argc, argv);
+        if(command == "predict")
+            return predictCommand(argc, argv);
+        if(command == "bench")
+            return benchCommand(argc, argv);
+        if(command == "test")
+            return testCommand(argc, argv);
+#ifdef HAVE_UNIX_SOCKETS
+        if(command == "serve")
+            return serveCommand(argc, argv);
+#endif
+        printUsage();
+        return command == "help" || command == "--help" || command == "-h" ? 0 : 1;
+    }
+
+    const vector<DatasetInfo>& datasets = knownDatasets();
+    cout << "Decision Tree Classifier\n";
+    cout << "Available Datasets:\n";
+    for(size_t d = 0; d < datasets.size(); d++)
+        cout << setw(3) << d + 1 << ". " << datasets[d].title << "\n";
+    cout << "Enter dataset number (1-" << datasets.size() << "): ";
+    
+    int choice = 0; 
+    cin >> choice;
+    if(choice < 1 || choice > (int)datasets.size()) {
+        cerr << "Invalid choice\n";
+        return 1;
+    }
+
+    const DatasetInfo& dataset = datasets[choice - 1];
+    string inputFile = dataset.file;
+    vector<string> attributeNames = dataset.attributeNames;
+    string labelName = dataset.labelName;
+
+    // Find label index from attribute names
+    int labelIndex = findLabel(attributeNames, labelName);
+    if(labelIndex == -1) {
+        cerr << "Label '" << labelName << "' not found in attributes!\n";
+        return 1;
+    }
+
+    cout << "\nSelect metric:\n";
+    cout << "1. Gini Index\n";
+    cout << "2. Information Gain\n";
+    cout << "3. Gain Ratio\n";
+    cout << "Enter choice (1-3): ";
+    
+    int metricChoice;
+    cin >> metricChoice;
+    
+    string metric;
+    if(metricChoice == 1) 
+        metric = "gini";
+    else if(metricChoice == 2) 
+        metric = "info";
+    else if(metricChoice == 3) 
+        metric = "gain";
+    else { 
+        cerr << "Invalid metric\n"; 
+        return 1; 
+    }
+
+    cout << "Enter number of threads (0 = all cores): ";
+    int threads = 0;
+    if(!(cin >> threads) || threads <= 0) //no answer or 0 means use every core
+        threads = max(1, (int)thread::hardware_concurrency());
+
+    cout << "Use histogram (binned) training for numeric columns? (y/n): ";
+    string histogramChoice;
+    cin >> histogramChoice;
+    bool histogram = histogramChoice == "y" || histogramChoice == "Y";
+
+    cout << "Number of trees (1 = single tree, more = random forest): ";
+    int numTrees = 1;
+    if(!(cin >> numTrees) || numTrees < 1) //no answer means a single tree
+        numTrees = 1;
+
+    cout << "Train online instead (Hoeffding tree, one row at a time)? (y/n): ";
+    string onlineChoice;
+    cin >> onlineChoice;
+    bool online = onlineChoice == "y" || onlineChoice == "Y";
+    if(online && numTrees > 1) { //the online learner grows one tree, a forest would be trained and predicted by nobody
+        cout << "Online training grows a single tree, ignoring the number of trees\n";
+        numTrees = 1;
+    }
+    bool seedOnline = false;
+    if(online) {
+        cout << "Start the online tree from a batch tree built on the first half of the training rows? (y/n): ";
+        string seedChoice;
+        cin >> seedChoice;
+        seedOnline = seedChoice == "y" || seedChoice == "Y";
+    }
+
+    cout << "Memory budget in MB for streaming (out of core) training (0 = load the whole file): ";
+    int budgetMB = 0;
+    if(!(cin >> budgetMB) || budgetMB < 0)
+        budgetMB = 0;
+
+    cout << "Number of cross validation folds (0 = one 70/30 holdout split): ";
+    int numFolds = 0;
+    if(!(cin >> numFolds) || numFolds < 2) //no answer means the usual holdout split
+        numFolds = 0;
+
+    cout << "Prune the tree on a held out quarter of the training rows (0 = no, 1 = reduced error, 2 = cost complexity): ";
+    int pruneMethod = 0;
+    if(!(cin >> pruneMethod) || pruneMethod < 0 || pruneMethod > 2) //no answer keeps the full tree
+        pruneMethod = 0;
+
+    cout << "Profile the run (phase summary and trace.json)? (y/n): ";
+    string profileChoice;
+    cin >> profileChoice;
+    if(profileChoice == "y" || profileChoice == "Y")
+        profiler.enable();
+
+    if(budgetMB > 0) { //the file is read in chunks over several passes and never held in memory
+        StreamOptions streamOptions;
+        streamOptions.memoryBudget = (size_t)budgetMB << 20;
+        cout << "\nStreaming data from: " << inputFile << " (numeric columns are always binned, one thread)\n";
+        auto start = chrono::high_resolution_clock::now();
+        StreamModel streamed = trainStreaming(inputFile, labelIndex, metric, attributeNames, streamOptions);
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        cout << "Streamed " << streamed.numRows << " samples (" << streamed.trainRows << " for training) in "
+             << streamed.passes << " passes, tree has " << streamed.flat.size() << " nodes\n";
+        if(saveModel("model.dtm", streamed.flat, streamed.schema, attributeNames, labelIndex))
+            cout << "Model saved to model.dtm\n";
+        else
+            cerr << "Error writing model.dtm\n";
+
+        BufferedWriter outFile("predictions.txt");
+        bool opened = outFile.ok();
+        if(!opened)
+            cerr << "Error opening predictions.txt for writing\n";
+        double testAcc = streamPredictions(inputFile, streamed, labelIndex, streamOptions, opened ? &outFile : nullptr);
+        cout << "\nTree Building Time: " << duration.count() / 1000.0 << " seconds" << endl;
+        cout << "Validation Accuracy: " << testAcc << "%\n";
+        if(opened && outFile.close())
+            cout << "\nAll predictions saved to predictions.txt\n";
+        else if(opened)
+            cerr << "Error writing predictions.txt\n";
+        reportProfile();
+        return 0;
+    }
+
+    cout << "\nLoading data from: " << inputFile << endl;
+
+    Dataset data = loadDataFile(inputFile, ',', labelIndex);
+    if(histogram || online) //the online tree splits numeric columns on bin bounds too
+        binNumericColumns(data);
+    vector<uint32_t> trainRows, testRows;
+    stratifiedSplit(data, labelIndex, trainRows, testRows);   // 70% train / 30% test, every class split the same way
+            
+    if(data.empty()) {
+        cerr << "No data loaded!\n";
+        return 1;
+    }
+    if(labelIndex >= (int)data.columns.size()) {
+        cerr << "Label column " << labelIndex << " is missing from " << inputFile << "\n";
+        return 1;
+    }
+        
+    cout << "Loaded " << data.size() << " samples with " << data.columns.size() << " attributes\n";
+    cout << "Target attribute: " << labelName << " (column " << labelIndex << ")\n";
+
+    // Display attribute names
+    cout << "\nAttributes:\n";
+    for(int i = 0; i < attributeNames.size(); i++) {
+        if(i == labelIndex) {
+            cout << "  [" << i << "] " << attributeNames[i] << " (TARGET)\n";
+        } else {
+            cout << "  [" << i << "] " << attributeNames[i] << (i < (int)data.columns.size() && data.columns[i].numeric ? " (numeric)" : "") << "\n";
+        }
+    }
+
+    vector<int> featureIndices;
+    for(int i = 0; i < (int)data.columns.size(); i++) {
+        if(i != labelIndex) {
+            featureIndices.push_back(i);
+        }
+    }
+    TrainOptions options;
+    options.threads = threads;
+    options.histogram = histogram;
+
+    if(numFolds > 0) { //report every fold, then stop
+        if(numFolds > (int)data.size()) {
+            cerr << "More folds than samples\n";
+            return 1;
+        }
+        reportCrossValidation(data, featureIndices, labelIndex, metric, attributeNames, options, numFolds, threads);
+        reportProfile();
+        return 0;
+    }
+
+    vector<uint32_t> allRows(data.size());
+    for(uint32_t i = 0; i < (uint32_t)data.size(); i++)
+        allRows[i] = i;
+
+    bool prune = pruneMethod > 0 && !online && numTrees == 1; //pruning works on the class counts of a single batch tree
+    vector<uint32_t> validationRows;
+    if(prune)
+        holdOutRows(trainRows, 0.25, DEFAULT_SEED, validationRows);
+
+    auto start = chrono::high_resolution_clock::now();
+
+    DecisionTree tree;
+    Forest forest;
+    FlatTree model; //prediction runs on the flat copy
+    if(online) {
+        model = withCriterion(metric, [&](auto criterion) { //the criterion is picked once for the whole stream
+            HoeffdingTree<decltype(criterion)> learner(data, labelIndex, attributeNames);
+            size_t seedRows = seedOnline ? trainRows.size() / 2 : 0; //the batch tree sees these, the rest stream in after it
+            if(seedRows > 0) {
+                vector<uint32_t> batchRows(trainRows.begin(), trainRows.begin() + seedRows);
+                DecisionTree batch = buildTree<decltype(criterion)>(data, batchRows, featureIndices, labelIndex, attributeNames, options);
+                learner.seed(batch.root, data, batchRows);
+                cout << "Online tree starts from a batch tree of " << countNodes(batch.root) << " nodes built on " << seedRows << " rows\n";
+            }
+            vector<Cell> row(data.columns.size());
+            for(size_t i = seedRows; i < trainRows.size(); i++) { //rows arrive one at a time
+                encodeRows(data, &trainRows[i], 1, row.data());
+                learner.learn(row.data());
+            }
+            cout << "Online tree learned " << learner.rowsLearned() << " rows into " << learner.size() << " nodes\n";
+            return learner.flatten();
+        });
+    } else if(numTrees > 1) {
+        ForestOptions forestOptions;
+        forestOptions.numTrees = numTrees;
+        forestOptions.threads = threads;
+        forestOptions.tree = options;
+        forest = trainForest(data, trainRows, featureIndices, labelIndex, metric, attributeNames, forestOptions);
+    } else {
+        tree = buildTree(data, trainRows, featureIndices, labelIndex, metric, attributeNames, options);
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+    if(prune)
+        pruneAndReport(tree, data, labelIndex, validationRows, pruneMethod);
+    else if(pruneMethod > 0)
+        cout << "Pruning only applies to a single batch tree, skipped\n";
+
+    vector<uint32_t> predictions; //every row is predicted once, the file and all the metrics read this
+    if(numTrees > 1) {
+        predictions = predictRows(forest, data, allRows);
+        cout << "Model files hold a single tree, the forest is not saved\n";
+    } else {
+        if(!online)
+            model = flattenTree(tree.root);
+        predictions = predictRows(model, data, allRows);
+        if(saveModel("model.dtm", model, data, attributeNames, labelIndex)) //scoring processes load this instead of retraining
+            cout << "Model saved to model.dtm (" << model.size() << " nodes)\n";
+        else
+            cerr << "Error writing model.dtm\n";
+    }
+
+    Evaluation eval = evaluate(predictions, data, testRows, labelIndex);
+    cout << "\nTree Building Time: " << duration.count() / 1000.0 << " seconds" << endl;
+    cout << "Validation Accuracy: " << eval.accuracy() << "%\n\n";
+    printEvaluation(eval, data, labelIndex);
+
+    if(!writePredictions("predictions.txt", predictions, data.columns[labelIndex], data, labelIndex))
+        cerr << "Error writing predictions.txt\n";
+    else
+        cout << "\nAll predictions saved to predictions.txt\n";
+    reportProfile();
+    return 0; //the tree's arena frees every node at once
 }
\ No newline at end of file